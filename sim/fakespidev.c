@@ -0,0 +1,245 @@
+/* SPDX-License-Identifier: [MIT] */
+
+/*
+ * Fake spidev for running host tools against the soc simulator.
+ *
+ *   LD_PRELOAD=sim/fakespidev.so ./robotsoc-io -a 0x400000
+ *
+ * Opening any /dev/spidev* device connects to the simulator socket
+ * ($ROBOTSOC_SIM, /tmp/robotsoc-sim.sock if unset). The application gets
+ * a /dev/null descriptor so it still looks like a character device, the
+ * SPI ioctls on it are forwarded to the simulator. Set FAKESPIDEV_VERBOSE
+ * to print the simulated cycle count of every message.
+ */
+
+#define _GNU_SOURCE
+#include <dlfcn.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <linux/spi/spidev.h>
+
+#include "simspi.h"
+
+static int spi_fd = -1;     /* what the application sees */
+static int sim_fd = -1;     /* connection to the simulator */
+static uint32_t spi_speed = 1000000;
+static uint32_t spi_mode;
+static uint8_t  spi_bits = 8;
+
+static int (*real_open)(const char *, int, ...);
+static int (*real_ioctl)(int, unsigned long, ...);
+static int (*real_close)(int);
+
+static void
+init(void)
+{
+    if (!real_open) {
+        real_open  = dlsym(RTLD_NEXT, "open");
+        real_ioctl = dlsym(RTLD_NEXT, "ioctl");
+        real_close = dlsym(RTLD_NEXT, "close");
+    }
+}
+
+static int
+xfer_all(int fd, void *buf, size_t len, int wr)
+{
+    char *p = buf;
+    while (len > 0) {
+        ssize_t rc = wr ? write(fd, p, len) : read(fd, p, len);
+        if (rc <= 0) {
+            if (rc < 0 && errno == EINTR)
+                continue;
+            return -1;
+        }
+        p += rc;
+        len -= rc;
+    }
+    return 0;
+}
+
+static int
+sim_connect(void)
+{
+    struct sockaddr_un sa = { .sun_family = AF_UNIX };
+    const char *path = getenv("ROBOTSOC_SIM");
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+    strncpy(sa.sun_path, path ? path : SIMSPI_SOCKET, sizeof(sa.sun_path) - 1);
+    if ((fd < 0) || connect(fd, (struct sockaddr*)&sa, sizeof(sa))) {
+        fprintf(stderr, "fakespidev: unable to connect to %s\n", sa.sun_path);
+        if (fd >= 0)
+            real_close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static int
+sim_message(struct spi_ioc_transfer *tr, int n)
+{
+    static simspi_xfer_t xf[SIMSPI_MAXXFER];
+    static uint8_t buf[SIMSPI_MAXBYTES];
+    simspi_req_t req = { SIMSPI_MAGIC, n, spi_speed, 0 };
+    simspi_rsp_t rsp;
+    int k;
+
+    if (n > SIMSPI_MAXXFER) {
+        errno = EMSGSIZE;
+        return -1;
+    }
+
+    for (k = 0; k < n; k++) {
+        if (req.bytes + tr[k].len > SIMSPI_MAXBYTES) {
+            errno = EMSGSIZE;
+            return -1;
+        }
+        xf[k].len = tr[k].len;
+        xf[k].cs_change = tr[k].cs_change;
+        if (tr[k].tx_buf)
+            memcpy(&buf[req.bytes], (void*)(uintptr_t)tr[k].tx_buf, tr[k].len);
+        else
+            memset(&buf[req.bytes], 0, tr[k].len);
+        req.bytes += tr[k].len;
+    }
+
+    if (xfer_all(sim_fd, &req, sizeof(req), 1)
+            || xfer_all(sim_fd, xf, n * sizeof(xf[0]), 1)
+            || xfer_all(sim_fd, buf, req.bytes, 1)
+            || xfer_all(sim_fd, &rsp, sizeof(rsp), 0)
+            || (rsp.bytes != req.bytes)
+            || xfer_all(sim_fd, buf, rsp.bytes, 0)) {
+        errno = EIO;
+        return -1;
+    }
+
+    if (getenv("FAKESPIDEV_VERBOSE"))
+        fprintf(stderr, "fakespidev: %d transfers, %u bytes, %llu cycles\n",
+            n, req.bytes, (unsigned long long)rsp.cycles);
+
+    uint32_t off = 0;
+    for (k = 0; k < n; k++) {
+        if (tr[k].rx_buf)
+            memcpy((void*)(uintptr_t)tr[k].rx_buf, &buf[off], tr[k].len);
+        off += tr[k].len;
+    }
+
+    if (rsp.rc) {
+        errno = EIO;
+        return -1;
+    }
+    return req.bytes;
+}
+
+int
+open(const char *path, int flags, ...)
+{
+    va_list ap;
+    mode_t mode;
+
+    init();
+    va_start(ap, flags);
+    mode = va_arg(ap, mode_t);
+    va_end(ap);
+
+    if (strncmp(path, "/dev/spidev", 11))
+        return real_open(path, flags, mode);
+
+    if (spi_fd >= 0) {
+        errno = EBUSY;
+        return -1;
+    }
+
+    sim_fd = sim_connect();
+    if (sim_fd < 0) {
+        errno = ENODEV;
+        return -1;
+    }
+
+    spi_fd = real_open("/dev/null", O_RDWR);
+    return spi_fd;
+}
+
+int
+open64(const char *path, int flags, ...)
+{
+    va_list ap;
+    mode_t mode;
+
+    va_start(ap, flags);
+    mode = va_arg(ap, mode_t);
+    va_end(ap);
+    return open(path, flags, mode);
+}
+
+int
+close(int fd)
+{
+    init();
+    if ((fd >= 0) && (fd == spi_fd)) {
+        real_close(sim_fd);
+        sim_fd = spi_fd = -1;
+    }
+    return real_close(fd);
+}
+
+int
+ioctl(int fd, unsigned long req, ...)
+{
+    va_list ap;
+    void *arg;
+
+    init();
+    va_start(ap, req);
+    arg = va_arg(ap, void*);
+    va_end(ap);
+
+    if ((fd < 0) || (fd != spi_fd))
+        return real_ioctl(fd, req, arg);
+
+    if (_IOC_TYPE(req) != SPI_IOC_MAGIC) {
+        errno = ENOTTY;
+        return -1;
+    }
+
+    switch (req) {
+        case SPI_IOC_WR_MODE:
+            spi_mode = *(uint8_t*)arg;
+            return 0;
+        case SPI_IOC_RD_MODE:
+            *(uint8_t*)arg = spi_mode;
+            return 0;
+        case SPI_IOC_WR_MODE32:
+            spi_mode = *(uint32_t*)arg;
+            return 0;
+        case SPI_IOC_RD_MODE32:
+            *(uint32_t*)arg = spi_mode;
+            return 0;
+        case SPI_IOC_WR_BITS_PER_WORD:
+            spi_bits = *(uint8_t*)arg;
+            return 0;
+        case SPI_IOC_RD_BITS_PER_WORD:
+            *(uint8_t*)arg = spi_bits;
+            return 0;
+        case SPI_IOC_WR_MAX_SPEED_HZ:
+            spi_speed = *(uint32_t*)arg;
+            return 0;
+        case SPI_IOC_RD_MAX_SPEED_HZ:
+            *(uint32_t*)arg = spi_speed;
+            return 0;
+    }
+
+    if ((_IOC_NR(req) == 0) && (_IOC_DIR(req) == _IOC_WRITE))
+        return sim_message(arg, _IOC_SIZE(req) / sizeof(struct spi_ioc_transfer));
+
+    errno = EINVAL;
+    return -1;
+}
@@ -0,0 +1,71 @@
+/* SPDX-License-Identifier: [MIT] */
+
+`default_nettype wire
+
+/*
+ * Behavioral stand-in for the Lattice single port block RAM primitive, for
+ * simulation only. Only the configuration used by wb_bram is modeled:
+ * "noreg" output (data valid the clock after the address), byte enables,
+ * "normal" write mode (output holds the old word during a write).
+ *
+ * The memory can be preloaded with +bram=<file>, one hex word per line.
+ * The file holds the whole image, sim_base is the word offset of this
+ * RAM in it. It's passed only when building for Verilator, the Lattice
+ * primitive has no such parameter.
+ */
+module pmi_ram_dq_be #(
+    parameter pmi_addr_depth = 4608,
+    parameter pmi_addr_width = 13,
+    parameter pmi_data_width = 32,
+    parameter pmi_regmode = "noreg",
+    parameter pmi_gsr = "disable",
+    parameter pmi_resetmode = "sync",
+    parameter pmi_optimization = "speed",
+    parameter pmi_write_mode = "normal",
+    parameter pmi_family = "common",
+    parameter pmi_init_file_format = "hex",
+    parameter pmi_init_file = "none",
+    parameter pmi_byte_size = 8,
+    parameter module_type = "pmi_ram_dq_be",
+    parameter sim_base = 0
+)(
+    input   [pmi_data_width-1:0]    Data,
+    input   [pmi_addr_width-1:0]    Address,
+    input                           Clock,
+    input                           ClockEn,
+    input                           WE,
+    input                           Reset,
+    input   [(pmi_data_width/pmi_byte_size)-1:0] ByteEn,
+    output reg [pmi_data_width-1:0] Q
+);
+
+    reg [pmi_data_width-1:0] mem [0:pmi_addr_depth-1];
+    reg [pmi_data_width-1:0] img [0:65535];
+
+    reg [1023:0] init_file;
+    integer n;
+    initial begin
+        for (n = 0; n < 65536; n = n + 1)
+            img[n] = 0;
+        if ($value$plusargs("bram=%s", init_file))
+            $readmemh(init_file, img);
+        for (n = 0; n < pmi_addr_depth; n = n + 1)
+            mem[n] = img[sim_base + n];
+    end
+
+    integer b;
+    always @(posedge Clock) begin
+        if (ClockEn) begin
+            if (WE && (Address < pmi_addr_depth)) begin
+                for (b = 0; b < pmi_data_width / pmi_byte_size; b = b + 1)
+                    if (ByteEn[b])
+                        mem[Address][b * pmi_byte_size +: pmi_byte_size]
+                            <= Data[b * pmi_byte_size +: pmi_byte_size];
+            end
+            Q <= mem[Address];
+        end
+        if (Reset)
+            Q <= 0;
+    end
+
+endmodule
@@ -0,0 +1,41 @@
+/* SPDX-License-Identifier: [MIT] */
+
+#ifndef SIMSPI_H
+#define SIMSPI_H
+
+#include <stdint.h>
+
+/*
+ * Wire protocol between the fake spidev (fakespidev.so) and the simulator
+ * (soc_sim). One request per SPI_IOC_MESSAGE ioctl, host byte order.
+ *
+ * Request:  simspi_req_t, nxfer x simspi_xfer_t, 'bytes' bytes of tx data
+ * Response: simspi_rsp_t, 'bytes' bytes of rx data
+ *
+ * Transfers without a tx buffer send zeros. Chip select is released
+ * between transfers that have cs_change set and at the end of the message.
+ */
+#define SIMSPI_MAGIC    0x4d495352 /* "RSIM" */
+#define SIMSPI_SOCKET   "/tmp/robotsoc-sim.sock"
+#define SIMSPI_MAXXFER  512
+#define SIMSPI_MAXBYTES (1 << 20)
+
+typedef struct {
+    uint32_t magic;
+    uint32_t nxfer;
+    uint32_t speed;     /* SPI clock in Hz, sets the simulated bit time */
+    uint32_t bytes;     /* total tx (and rx) bytes */
+} simspi_req_t;
+
+typedef struct {
+    uint32_t len;
+    uint32_t cs_change;
+} simspi_xfer_t;
+
+typedef struct {
+    int32_t  rc;
+    uint32_t bytes;
+    uint64_t cycles;    /* system clocks the message took */
+} simspi_rsp_t;
+
+#endif
@@ -0,0 +1,462 @@
+/* SPDX-License-Identifier: [MIT] */
+
+/*
+ * Verilator harness for soc.v. Host tools talk to the simulated SPI slave
+ * through fakespidev.so, see simspi.h for the socket protocol. The SPI pins
+ * are bit banged from the harness at the requested SPI clock rate, so the
+ * cycle counts match the real link.
+ *
+ *   soc_sim [options]
+ *     --socket PATH    listen on PATH, /tmp/robotsoc-sim.sock if omitted
+ *     --bin FILE       preload BRAM with a binary image
+ *     --reset MASK     write the CPU reset register at startup
+ *     --spi-div N      system clocks per SPI half bit, overrides the speed
+ *                      requested by the client
+ *     --ppm US         drive both R/C receiver inputs with US wide pulses
+ *     --loop-addr ADR  count bus writes to byte ADR, reports cycles per loop
+ *     --warmup N       ignore loop counter writes in the first N clocks
+ *     --loops N        exit after N writes to the loop address
+ *     --cycles N       exit after N system clocks
+ *     -v               print every SPI message
+ *
+ * On exit the harness prints a report of key=value lines on stdout.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "Vsoc.h"
+#include "Vsoc___024root.h"
+#include "verilated.h"
+
+#include "simspi.h"
+
+#define SYSCLK_HZ       50000000
+#define BRAM_DEPTH      4608
+#define CPU_RESET_ADDR  0x100000
+#define POLL_CYCLES     4096
+
+static Vsoc *top;
+static uint64_t cycles;
+static volatile sig_atomic_t stop;
+
+/* Options */
+static int spi_div;
+static int ppm_us;
+static uint32_t loop_addr = 0xFFFFFFFF;
+static uint64_t max_loops;
+static uint64_t warmup;
+static uint64_t max_cycles;
+static int verbose;
+
+/* SPI statistics */
+static uint64_t spi_msgs;
+static uint64_t spi_cmds;
+static uint64_t spi_bytes;
+static uint64_t spi_cycles;
+static uint64_t spi_max;
+
+/* Firmware loop statistics, cycles between writes to loop_addr */
+static uint64_t loop_count;
+static uint64_t loop_first;
+static uint64_t loop_last;
+static uint64_t loop_min = UINT64_MAX;
+static uint64_t loop_max;
+
+static void
+on_signal(int sig)
+{
+    stop = 1;
+}
+
+/*
+ * R/C receiver pulses, US wide every 20mS, same as a servo receiver
+ */
+static void
+ppm_drive(void)
+{
+    if (!ppm_us)
+        return;
+    uint64_t t = cycles % (SYSCLK_HZ / 50);
+    top->ppmi = (t < (uint64_t)ppm_us * (SYSCLK_HZ / 1000000)) ? 0x3 : 0x0;
+}
+
+/*
+ * Watch for firmware loop counter updates. CPU0 writes block RAM through
+ * its own port, everything else shows up on the shared bus.
+ */
+static void
+bus_watch(void)
+{
+    Vsoc___024root *r = top->rootp;
+    uint32_t adr, sel;
+    if (r->soc__DOT__wb_cpm_cyc && r->soc__DOT__wb_cpm_we
+            && r->soc__DOT__wb_cpm_ack) {
+        adr = r->soc__DOT__wb_cpm_adr;
+        sel = r->soc__DOT__wb_cpm_sel;
+    } else if (r->soc__DOT__wb_bus_cyc && r->soc__DOT__wb_bus_we
+            && r->soc__DOT__wb_bus_ack) {
+        adr = r->soc__DOT__wb_bus_adr;
+        sel = r->soc__DOT__wb_bus_sel;
+    } else {
+        return;
+    }
+    if ((adr & 0xFFFFFC) != (loop_addr & 0xFFFFFC))
+        return;
+    if (!(sel & (1 << (loop_addr & 3))) || (cycles < warmup))
+        return;
+
+    if (loop_count) {
+        uint64_t d = cycles - loop_last;
+        loop_min = (d < loop_min) ? d : loop_min;
+        loop_max = (d > loop_max) ? d : loop_max;
+    } else {
+        loop_first = cycles;
+    }
+    loop_last = cycles;
+    loop_count++;
+
+    if (max_loops && (loop_count > max_loops))
+        stop = 1;
+}
+
+static void
+tick(void)
+{
+    ppm_drive();
+    top->clk = 0;
+    top->eval();
+    top->clk = 1;
+    top->eval();
+    cycles++;
+    bus_watch();
+}
+
+static void
+run(int n)
+{
+    while (n-- > 0)
+        tick();
+}
+
+/* Mode 0, MSB first. Data out before the rising edge, sample on it. */
+static uint8_t
+spi_byte(uint8_t tx, int div)
+{
+    uint8_t rx = 0;
+    int k;
+    for (k = 7; k >= 0; k--) {
+        top->spi_mosi = (tx >> k) & 1;
+        run(div);
+        top->spi_clk = 1;
+        top->eval();
+        rx = (rx << 1) | (top->spi_miso & 1);
+        run(div);
+        top->spi_clk = 0;
+    }
+    return rx;
+}
+
+/*
+ * Run one SPI_IOC_MESSAGE. Chip select goes high between transfers with
+ * cs_change set, and at the end of the message.
+ */
+static uint64_t
+spi_message(const simspi_xfer_t *xf, int n, uint8_t *buf, int div)
+{
+    uint64_t start = cycles;
+    uint32_t off = 0, i;
+    int k;
+
+    top->spi_csn = 0;
+    run(div);
+    spi_cmds++;
+    for (k = 0; k < n; k++) {
+        for (i = 0; i < xf[k].len; i++, off++)
+            buf[off] = spi_byte(buf[off], div);
+
+        if (xf[k].cs_change && (k < n - 1)) {
+            run(div);
+            top->spi_csn = 1;
+            run(2 * div);
+            top->spi_csn = 0;
+            run(div);
+            spi_cmds++;
+        }
+    }
+    run(div);
+    top->spi_csn = 1;
+    run(2 * div);
+
+    uint64_t c = cycles - start;
+    spi_msgs++;
+    spi_bytes += off;
+    spi_cycles += c;
+    spi_max = (c > spi_max) ? c : spi_max;
+    return c;
+}
+
+static int
+speed_div(uint32_t speed)
+{
+    if (spi_div)
+        return spi_div;
+    int div = speed ? (SYSCLK_HZ / 2) / speed : 25;
+    return (div < 2) ? 2 : div;
+}
+
+/* Write the CPU reset register, same as robotsoc-io does over SPI */
+static void
+cpu_reset(uint32_t mask)
+{
+    uint8_t buf[8] = {
+        0x0F, (CPU_RESET_ADDR >> 16) & 0xFF, (CPU_RESET_ADDR >> 8) & 0xFF, 0,
+        (uint8_t)(mask >> 24), (uint8_t)(mask >> 16), (uint8_t)(mask >> 8), (uint8_t)mask
+    };
+    simspi_xfer_t xf = { sizeof(buf), 0 };
+    spi_message(&xf, 1, buf, speed_div(0));
+}
+
+static int
+xfer_all(int fd, void *buf, size_t len, int wr)
+{
+    char *p = (char*)buf;
+    while (len > 0) {
+        ssize_t rc = wr ? write(fd, p, len) : read(fd, p, len);
+        if (rc <= 0) {
+            if (rc < 0 && errno == EINTR)
+                continue;
+            return -1;
+        }
+        p += rc;
+        len -= rc;
+    }
+    return 0;
+}
+
+/* Serve one request from a client. Returns -1 when the client is gone. */
+static int
+serve(int fd)
+{
+    static simspi_xfer_t xf[SIMSPI_MAXXFER];
+    static uint8_t buf[SIMSPI_MAXBYTES];
+    simspi_req_t req;
+    simspi_rsp_t rsp = { 0, 0, 0 };
+    uint32_t total = 0, k;
+
+    if (xfer_all(fd, &req, sizeof(req), 0))
+        return -1;
+    if ((req.magic != SIMSPI_MAGIC) || (req.nxfer > SIMSPI_MAXXFER)
+            || (req.bytes > SIMSPI_MAXBYTES)) {
+        fprintf(stderr, "soc_sim: bad request\n");
+        return -1;
+    }
+    if (xfer_all(fd, xf, req.nxfer * sizeof(xf[0]), 0)
+            || xfer_all(fd, buf, req.bytes, 0))
+        return -1;
+
+    for (k = 0; k < req.nxfer; k++)
+        total += xf[k].len;
+    if (total != req.bytes) {
+        fprintf(stderr, "soc_sim: bad request\n");
+        return -1;
+    }
+
+    rsp.bytes  = req.bytes;
+    rsp.cycles = spi_message(xf, req.nxfer, buf, speed_div(req.speed));
+    if (verbose)
+        fprintf(stderr, "spi: %u transfers, %u bytes, %llu cycles\n",
+            req.nxfer, req.bytes, (unsigned long long)rsp.cycles);
+
+    if (xfer_all(fd, &rsp, sizeof(rsp), 1) || xfer_all(fd, buf, rsp.bytes, 1))
+        return -1;
+    return 0;
+}
+
+/* Convert a binary image to a $readmemh file for the BRAM model */
+static int
+bin_to_hex(const char *bin, char *hex, size_t len)
+{
+    static uint32_t mem[BRAM_DEPTH];
+    FILE *in = fopen(bin, "rb");
+    if (!in) {
+        fprintf(stderr, "soc_sim: unable to open %s\n", bin);
+        return -1;
+    }
+    size_t n = fread(mem, 1, sizeof(mem), in);
+    fclose(in);
+
+    snprintf(hex, len, "/tmp/soc_sim.%d.hex", (int)getpid());
+    FILE *out = fopen(hex, "w");
+    if (!out)
+        return -1;
+    for (n = 0; n < BRAM_DEPTH; n++)
+        fprintf(out, "%08X\n", mem[n]); /* assumes a LE host */
+    fclose(out);
+    return 0;
+}
+
+static void
+report(void)
+{
+    printf("cycles=%llu\n", (unsigned long long)cycles);
+    printf("spi_messages=%llu\n", (unsigned long long)spi_msgs);
+    printf("spi_commands=%llu\n", (unsigned long long)spi_cmds);
+    printf("spi_bytes=%llu\n", (unsigned long long)spi_bytes);
+    printf("spi_cycles=%llu\n", (unsigned long long)spi_cycles);
+    printf("spi_cycles_max=%llu\n", (unsigned long long)spi_max);
+    if (spi_msgs)
+        printf("spi_cycles_avg=%.1f\n", (double)spi_cycles / spi_msgs);
+
+    if (loop_addr != 0xFFFFFFFF) {
+        printf("loop_addr=0x%x\n", loop_addr);
+        printf("loop_count=%llu\n", (unsigned long long)loop_count);
+        if (loop_count > 1) {
+            double avg = (double)(loop_last - loop_first) / (loop_count - 1);
+            printf("loop_cycles_avg=%.1f\n", avg);
+            printf("loop_cycles_min=%llu\n", (unsigned long long)loop_min);
+            printf("loop_cycles_max=%llu\n", (unsigned long long)loop_max);
+            printf("loop_rate_hz=%.0f\n", SYSCLK_HZ / avg);
+        }
+    }
+    fflush(stdout);
+}
+
+static void
+usage(void)
+{
+    printf("usage: soc_sim [--socket PATH] [--bin FILE] [--reset MASK]\n"
+        "               [--spi-div N] [--ppm US] [--loop-addr ADR]\n"
+        "               [--warmup N] [--loops N] [--cycles N] [-v]\n");
+}
+
+int
+main(int argc, char **argv)
+{
+    const char *path = SIMSPI_SOCKET;
+    const char *bin = NULL;
+    long reset = -1;
+    char hex[64];
+    char plus[80];
+    int k;
+
+    for (k = 1; k < argc; k++) {
+        const char *a = argv[k];
+        const char *v = (k + 1 < argc) ? argv[k + 1] : NULL;
+        if (!strcmp(a, "-v")) {
+            verbose = 1;
+            continue;
+        }
+        if (!strcmp(a, "-h") || !v) {
+            usage();
+            return strcmp(a, "-h") ? 1 : 0;
+        }
+        if (!strcmp(a, "--socket"))
+            path = v;
+        else if (!strcmp(a, "--bin"))
+            bin = v;
+        else if (!strcmp(a, "--reset"))
+            reset = strtol(v, NULL, 0);
+        else if (!strcmp(a, "--spi-div"))
+            spi_div = strtol(v, NULL, 0);
+        else if (!strcmp(a, "--ppm"))
+            ppm_us = strtol(v, NULL, 0);
+        else if (!strcmp(a, "--loop-addr"))
+            loop_addr = strtoul(v, NULL, 0);
+        else if (!strcmp(a, "--warmup"))
+            warmup = strtoull(v, NULL, 0);
+        else if (!strcmp(a, "--loops"))
+            max_loops = strtoull(v, NULL, 0);
+        else if (!strcmp(a, "--cycles"))
+            max_cycles = strtoull(v, NULL, 0);
+        else {
+            usage();
+            return 1;
+        }
+        k++;
+    }
+
+    /* The BRAM model picks up its init file from a plusarg */
+    const char *vargs[2] = { argv[0], plus };
+    int nvargs = 1;
+    if (bin) {
+        if (bin_to_hex(bin, hex, sizeof(hex)))
+            return 1;
+        snprintf(plus, sizeof(plus), "+bram=%s", hex);
+        nvargs = 2;
+    }
+    Verilated::commandArgs(nvargs, vargs);
+
+    top = new Vsoc;
+    top->clk = 0;
+    top->spi_csn = 1;
+    top->spi_clk = 0;
+    top->spi_mosi = 0;
+    top->gpi = 0;
+    top->ebrake = 0;
+    top->ppmi = 0;
+    top->eval();
+    if (bin)
+        unlink(hex);
+
+    if (reset >= 0)
+        cpu_reset((uint32_t)reset);
+
+    struct sockaddr_un sa = {};
+    sa.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(sa.sun_path)) {
+        fprintf(stderr, "soc_sim: socket path too long: %s\n", path);
+        return 1;
+    }
+    strcpy(sa.sun_path, path);
+    unlink(path);
+
+    int lfd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if ((lfd < 0) || bind(lfd, (struct sockaddr*)&sa, sizeof(sa))
+            || listen(lfd, 1)) {
+        fprintf(stderr, "soc_sim: unable to listen on %s\n", path);
+        return 1;
+    }
+
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+    signal(SIGPIPE, SIG_IGN);
+    fprintf(stderr, "soc_sim: listening on %s\n", path);
+
+    /*
+     * One client at a time. The simulation keeps running between requests
+     * so the firmware sees the same gaps it would on the real link.
+     */
+    int cfd = -1;
+    while (!stop && !(max_cycles && cycles >= max_cycles)) {
+        struct pollfd pfd = { (cfd < 0) ? lfd : cfd, POLLIN, 0 };
+        if (poll(&pfd, 1, 0) > 0) {
+            if (cfd < 0) {
+                cfd = accept(lfd, NULL, NULL);
+            } else if (serve(cfd)) {
+                close(cfd);
+                cfd = -1;
+            }
+        }
+        run(POLL_CYCLES);
+    }
+
+    if (cfd >= 0)
+        close(cfd);
+    close(lfd);
+    unlink(path);
+
+    top->final();
+    report();
+    delete top;
+    return 0;
+}
@@ -17,7 +17,8 @@ module gio(
     output  [31:0]  wb_rdt,
     output          wb_ack,
 
-    input   [3:0]   busid,
+    input   [7:0]   hart,   // one-hot, bit N for hart N, 0 for other masters
+    input   [15:0]  us,     // microsecond counter, R/C input timestamps
     
     output  [7:0]   gpo, // 7x LED, 1x drive enable
     input   [7:0]   gpi, // 8x active low
@@ -35,7 +36,9 @@ module gio(
     output [7:0]    pwmo,
 
     output          ppms,   /* PPM stream */
-    output  [7:0]   ppmo    /* R/C servo demuxed */
+    output  [7:0]   ppmo,   /* R/C servo demuxed */
+
+    output  [223:0] tlm     /* rdt6 - rdt0, for the telemetry sampler */
 );
 
     reg ack;
@@ -83,10 +86,16 @@ module gio(
     wire [31:0] rdt_ppmo_03;
     wire [31:0] rdt_ppmo_47;
 
-    /* R/C receiver input */
+    /* Status, brake input, reading hart & millisecond counter */
+    wire [31:0] rdt_stat = {eb_rst, 7'h0, hart, ms_cnt};
+
+    /* R/C receiver input, channels 0 & 1 at 8 bits */
     wire [31:0] rdt_ppmi_01;
-    assign rdt_ppmi_01[15:9]  = 7'h0;
-    assign rdt_ppmi_01[31:25] = 7'h0;
+    wire [7:0]  ppmi_lock;
+    wire [7:0]  ppmi_smp;
+    wire [63:0] ppmi_mag;
+    assign rdt_ppmi_01 = {7'h0, ppmi_lock[1], ppmi_mag[15:8],
+                          7'h0, ppmi_lock[0], ppmi_mag[7:0]};
 
     /*
      * Write enable decoder:
@@ -94,7 +103,7 @@ module gio(
      * Individual byte write enables are available as needed.
      */
     dec3x8 wadr_decode(
-        .en(wb_cyc & wb_stb & wb_we),
+        .en(wb_cyc & wb_stb & wb_we & (wb_adr[7:5] == 3'h0)),
         .adr(wb_adr[4:2]),
         .sel(we_strobe));
     /*
@@ -102,10 +111,11 @@ module gio(
      * There are no byte level read side effects so byte selects are ignored.
      * Return data is always the full 32-bit word.
      */
+    wire [31:0] rdt_bank0;
     mux3x8 rdat_decode(
         .adr(wb_adr[4:2]),
-        .rdt(wb_rdt),
-        .rdt0({eb_rst, 11'h0, busid, ms_cnt}), // Add limit switch input status
+        .rdt(rdt_bank0),
+        .rdt0(rdt_stat), // Add limit switch input status
         .rdt1(rdt_ppmi_01),
         .rdt2(rdt_ppmo_03),
         .rdt3(rdt_ppmo_47),
@@ -115,6 +125,41 @@ module gio(
         .rdt7(32'hdead0005)
     );
 
+    /*
+     * 0x20 - 0x3C: PPM to PWM mixer config, one word per pcpwm channel
+     */
+    wire [31:0] rdt_mix;
+    wire        we_mix = wb_cyc & wb_stb & wb_we & (wb_adr[7:5] == 3'h1);
+
+    /*
+     * 0x40 - 0x7C: R/C receiver capture, control and flags at 0x40,
+     * channels at 0x60. Reading a channel clears its new sample flag.
+     */
+    wire [31:0] rdt_cap;
+    wire        cap_sel = (wb_adr[7:6] == 2'h1);
+    wire        we_cap  = wb_cyc & wb_stb & wb_we & cap_sel;
+    wire        rd_cap  = ack & wb_cyc & wb_stb & !wb_we & cap_sel;
+
+    /*
+     * 0x80: PWM control
+     *  [15:8]=prescaler, [5:4]=resolution, 11 - n counter bits,
+     *  [1]=commit (write 1, reads 1 until the turnaround),
+     *  [0]=shadow, channel writes wait for a commit
+     */
+    reg  [15:0] pwm_ctl = 16'h0;
+    reg         pwm_commit = 1'b0;
+    wire        pwm_turn;
+    wire        we_pwmc = wb_cyc & wb_stb & wb_we & (wb_adr[7:2] == 6'h20);
+    wire [31:0] rdt_pwmc = {16'h0, pwm_ctl[15:2], pwm_commit, pwm_ctl[0]};
+
+    assign wb_rdt = (wb_adr[7:5] == 3'h0) ? rdt_bank0 :
+                    (wb_adr[7:5] == 3'h1) ? rdt_mix :
+                    cap_sel               ? rdt_cap :
+                    (wb_adr[7:2] == 6'h20) ? rdt_pwmc : 32'hdead0005;
+
+    assign tlm = {rdt_gpio_07, rdt_pwmo_47, rdt_pwmo_03, rdt_ppmo_47,
+                  rdt_ppmo_03, rdt_ppmi_01, rdt_stat};
+
     always @(posedge wb_clk) begin
         /* All modules return data within a single cycle */
         ack <= !ack && wb_cyc && wb_stb;
@@ -127,42 +172,92 @@ module gio(
         .gpi(gpi),                      .gpo(gpo)
     );
 
-    /* 8x pulse width modulators */
-    pcpwm hb_01(.clk(wb_clk), .rst(eb_rst), .trig(),
-        .we_a(we_pwmo_03 & wb_sel[0]),  .we_b(we_pwmo_03 & wb_sel[1]),
-        .maga(wb_dat[7:0]),             .magb(wb_dat[15:8]),
+    /* 8x pulse width modulators, written by the bus or by the mixer */
+    wire [7:0]  we_mix_pwm;
+    wire [63:0] mix_pwm;
+    wire [7:0]  we_pwm = ({{4{we_pwmo_47}}, {4{we_pwmo_03}}} & {wb_sel, wb_sel}) |
+                         we_mix_pwm;
+    wire [63:0] mag_pwm;
+
+    /*
+     * All channels switch to their new values together at the counter
+     * turnaround after a commit. Mixer updates commit on their own.
+     */
+    always @(posedge wb_clk) begin
+        if (we_pwmc && wb_sel[0])
+            pwm_ctl[7:0] <= {2'h0, wb_dat[5:4], 3'h0, wb_dat[0]};
+        if (we_pwmc && wb_sel[1])
+            pwm_ctl[15:8] <= wb_dat[15:8];
+
+        if ((we_pwmc && wb_sel[0] && wb_dat[1]) || (|we_mix_pwm))
+            pwm_commit <= 1'b1;
+        else if (pwm_turn)
+            pwm_commit <= 1'b0;
+    end
+
+    wire        pwm_load = !pwm_ctl[0] || pwm_commit;
+
+    genvar c;
+    generate
+        for (c = 0; c < 8; c = c + 1) begin : pwm_src
+            assign mag_pwm[8*c +: 8] = we_mix_pwm[c] ? mix_pwm[8*c +: 8] :
+                                                       wb_dat[8*(c%4) +: 8];
+        end
+    endgenerate
+
+    pcpwm hb_01(.clk(wb_clk), .rst(eb_rst), .trig(), .turn(pwm_turn),
+        .load(pwm_load),                .res(pwm_ctl[5:4]),
+        .pre(pwm_ctl[15:8]),
+        .we_a(we_pwm[0]),               .we_b(we_pwm[1]),
+        .maga(mag_pwm[7:0]),            .magb(mag_pwm[15:8]),
         .rdta(rdt_pwmo_03[7:0]),        .rdtb(rdt_pwmo_03[15:8]),
         .pwma(pwmo[0]),                 .pwmb(pwmo[1])
     );
 
-    pcpwm hb_23(.clk(wb_clk), .rst(eb_rst), .trig(),
-        .we_a(we_pwmo_03 & wb_sel[2]),  .we_b(we_pwmo_03 & wb_sel[3]),
-        .maga(wb_dat[23:16]),           .magb(wb_dat[31:24]),
+    pcpwm hb_23(.clk(wb_clk), .rst(eb_rst), .trig(), .turn(),
+        .load(pwm_load),                .res(pwm_ctl[5:4]),
+        .pre(pwm_ctl[15:8]),
+        .we_a(we_pwm[2]),               .we_b(we_pwm[3]),
+        .maga(mag_pwm[23:16]),          .magb(mag_pwm[31:24]),
         .rdta(rdt_pwmo_03[23:16]),      .rdtb(rdt_pwmo_03[31:24]),
         .pwma(pwmo[2]),                 .pwmb(pwmo[3])
     );
 
-    pcpwm hb_45(.clk(wb_clk), .rst(eb_rst), .trig(),
-        .we_a(we_pwmo_47 & wb_sel[0]),  .we_b(we_pwmo_47 & wb_sel[1]),
-        .maga(wb_dat[7:0]),             .magb(wb_dat[15:8]),
+    pcpwm hb_45(.clk(wb_clk), .rst(eb_rst), .trig(), .turn(),
+        .load(pwm_load),                .res(pwm_ctl[5:4]),
+        .pre(pwm_ctl[15:8]),
+        .we_a(we_pwm[4]),               .we_b(we_pwm[5]),
+        .maga(mag_pwm[39:32]),          .magb(mag_pwm[47:40]),
         .rdta(rdt_pwmo_47[7:0]),        .rdtb(rdt_pwmo_47[15:8]),
         .pwma(pwmo[4]),                 .pwmb(pwmo[5])
     );
 
-    pcpwm hb_67(.clk(wb_clk), .rst(eb_rst), .trig(),
-        .we_a(we_pwmo_47 & wb_sel[2]),  .we_b(we_pwmo_47 & wb_sel[3]),
-        .maga(wb_dat[23:16]),           .magb(wb_dat[31:24]),
+    pcpwm hb_67(.clk(wb_clk), .rst(eb_rst), .trig(), .turn(),
+        .load(pwm_load),                .res(pwm_ctl[5:4]),
+        .pre(pwm_ctl[15:8]),
+        .we_a(we_pwm[6]),               .we_b(we_pwm[7]),
+        .maga(mag_pwm[55:48]),          .magb(mag_pwm[63:56]),
         .rdta(rdt_pwmo_47[23:16]),      .rdtb(rdt_pwmo_47[31:24]),
         .pwma(pwmo[6]),                 .pwmb(pwmo[7])
     );
 
-    /* 2x pulse position inputs */
-    ppmi ppmi_00(.clk(wb_clk),          .ppm(ppmi[0]),
-        .lock(rdt_ppmi_01[8]),          .mag(rdt_ppmi_01[7:0])
+    /* Pulse position inputs, 2x servo or 8x PPM-sum */
+    ppmcap ppmi_07(.clk(wb_clk),        .ppm(ppmi),
+        .us(us),
+        .adr(wb_adr[5:2]),              .we(we_cap),
+        .rd(rd_cap),                    .dat(wb_dat),
+        .rdt(rdt_cap),
+        .lock(ppmi_lock),               .smp(ppmi_smp),
+        .mag(ppmi_mag)
     );
 
-    ppmi ppmi_01(.clk(wb_clk),          .ppm(ppmi[1]),
-        .lock(rdt_ppmi_01[24]),         .mag(rdt_ppmi_01[23:16])
+    /* PPM to PWM mixer, drives the pulse width modulators on new samples */
+    ppmmix #(.INPUTS(8)) mix(.clk(wb_clk),
+        .we(we_mix),                    .ch(wb_adr[4:2]),
+        .sel(wb_sel),                   .dat(wb_dat),
+        .rdt(rdt_mix),
+        .smp(ppmi_smp),                 .mag(ppmi_mag),
+        .we_pwm(we_mix_pwm),            .pwm(mix_pwm)
     );
 
     /* 8x pulse position + ppm stream outputs */
@@ -6,6 +6,10 @@ module pcpwm(
     input           clk, // 50MHz
     input           rst,
 
+    input           load, /* take the written values at the next turnaround */
+    input   [1:0]   res,  /* counter is 11 - res bits */
+    input   [7:0]   pre,  /* counter steps every pre + 1 clocks */
+
     input           we_a, /* write channel a */
     input           we_b, /* write channel b */
     input   [7:0]   maga, /* Channel A, 128 = 50% duty cycle */
@@ -14,7 +18,8 @@ module pcpwm(
     output  [7:0]   rdtb,
     output  reg     pwma,
     output  reg     pwmb,
-    output          trig /* Trigger output */
+    output          trig, /* Trigger output */
+    output          turn  /* counter turnaround, the values were loaded */
 );
 
     /*
@@ -30,13 +35,25 @@ module pcpwm(
         wdt <= (wdt[23] | wdt_pet) ? 24'h0 : wdt + 1;
     end
 
-    /* 11 bit up/down counter. @50MHz --> 12.2KHz frequency. */
-    reg         dir;
+    /*
+     * 11 bit up/down counter. @50MHz --> 12.2KHz frequency. 'res' drops
+     * counter bits and 'pre' slows it down, frequency is
+     * 50MHz / (2^(12 - res) * (pre + 1)). Both change at a turnaround.
+     */
+    reg         dir = 1'b0;
     assign      trig = dir;
 
+    reg [1:0]   res_reg = 2'h0;
+    reg [7:0]   pre_reg = 8'h0;
+    reg [7:0]   pdiv = 8'h0;
+    wire        step = (pdiv == pre_reg);
+
     reg [10:0]  cnt = 11'h0;
-    wire        cnt_max = (cnt == 11'h7ff);
+    wire [10:0] cnt_top = 11'h7ff >> res_reg;
+    wire [10:0] cnt_cmp = cnt << res_reg;
+    wire        cnt_max = (cnt == cnt_top);
     wire        cnt_min = (cnt == 11'h000);
+    assign      turn = cnt_min && !dir && step;
 
     /* Input holding and readback registers */
     reg [7:0]   data;
@@ -44,9 +61,9 @@ module pcpwm(
     assign rdta = data;
     assign rdtb = datb;
 
-    /* PWM compare registers, updated when ramp == 0 */
-    reg [7:0]   maga_reg;
-    reg [7:0]   magb_reg;
+    /* PWM compare registers, updated at the turnaround when ramp == 0 */
+    reg [7:0]   maga_reg = 8'h0;
+    reg [7:0]   magb_reg = 8'h0;
     wire        maga_max = &maga_reg;
     wire        magb_max = &magb_reg;
 
@@ -64,23 +81,34 @@ module pcpwm(
 
         /*
          * Magnitude values are registered on the beginning of a cycle to
-         * prevent glitches in the output.
+         * prevent glitches in the output. Without 'load' the old values
+         * stay, except on a reset, so the outputs still stop.
          */
-        maga_reg <= (cnt_min) ? data : maga_reg;
-        magb_reg <= (cnt_min) ? datb : magb_reg;
+        if (turn && (load || mag_rst)) begin
+            maga_reg <= data;
+            magb_reg <= datb;
+        end
+        if (turn) begin
+            res_reg <= res;
+            pre_reg <= pre;
+        end
 
-        dir <= (cnt_max) ? 1'b0 :
-                (cnt_min) ? 1'b1 : dir;
-        /*
-         * This counter stays at the min & max values for 2 clock cycles
-         */ 
-        cnt <= (dir && !(cnt_max)) ? cnt + 1 :
-                (!dir && !(cnt_min)) ? cnt - 1 : cnt;
+        pdiv <= (step) ? 8'h0 : pdiv + 8'h1;
+
+        if (step) begin
+            dir <= (cnt_max) ? 1'b0 :
+                    (cnt_min) ? 1'b1 : dir;
+            /*
+             * This counter stays at the min & max values for 2 steps
+             */ 
+            cnt <= (dir && !(cnt_max)) ? cnt + 1 :
+                    (!dir && !(cnt_min)) ? cnt - 1 : cnt;
+        end
     end
 
     always @ (posedge clk) begin
-        pwma <= ~(cnt[10:3] >= maga_reg) | maga_max;
-        pwmb <= ~(cnt[10:3] >= magb_reg) | magb_max;
+        pwma <= ~(cnt_cmp[10:3] >= maga_reg) | maga_max;
+        pwmb <= ~(cnt_cmp[10:3] >= magb_reg) | magb_max;
     end
 
 endmodule
@@ -0,0 +1,103 @@
+/* SPDX-License-Identifier: [MIT] */
+
+`default_nettype wire
+
+/*
+ * R/C receiver capture, 8 channels. Either a servo pulse on each of the
+ * two ppmi pins, channels 0 and 1, or a PPM-sum stream on one of them
+ * filling all 8. Every new sample is timestamped and sets the channel's
+ * new flag.
+ *
+ * Offsets from 0x400040 on the gio bus:
+ * 0x00 = Control (read write)
+ *  [1]=PPM-sum pin, [0]=PPM-sum mode
+ * 0x04 = Flags (read only)
+ *  [15:8]=locked, [7:0]=new sample
+ * 0x20 - 0x3C = Channel 0 - 7 (read only)
+ *  [31:16]=timestamp, us counter when the sample completed
+ *  [15]=new sample, cleared by reading this word
+ *  [14]=locked, [11:0]=position, 2048 = center
+ */
+module ppmcap(
+    input           clk,
+    input   [1:0]   ppm,        /* R/C receiver inputs */
+    input   [15:0]  us,         /* timestamp counter */
+
+    /* Registers, adr is the word offset */
+    input   [3:0]   adr,
+    input           we,
+    input           rd,         /* read, in the clock it completes */
+    input   [31:0]  dat,
+    output  [31:0]  rdt,
+
+    /* All channels, 8 bits, for the legacy register and the mixer */
+    output  [7:0]   lock,
+    output  [7:0]   smp,
+    output  [63:0]  mag
+);
+
+    reg [1:0] ctl = 2'h0;
+    wire sum_en  = ctl[0];
+    wire sum_pin = ctl[1];
+
+    always @(posedge clk) begin
+        if (we && (adr == 4'h0))
+            ctl <= dat[1:0];
+    end
+
+    /* One servo pulse per pin */
+    wire [1:0]  s_lock;
+    wire [1:0]  s_smp;
+    wire [23:0] s_pos;
+
+    ppmi ppmi_00(.clk(clk),             .ppm(ppm[0]),
+        .lock(s_lock[0]),               .smp(s_smp[0]),
+        .mag(),                         .pos(s_pos[11:0])
+    );
+
+    ppmi ppmi_01(.clk(clk),             .ppm(ppm[1]),
+        .lock(s_lock[1]),               .smp(s_smp[1]),
+        .mag(),                         .pos(s_pos[23:12])
+    );
+
+    /* PPM-sum stream */
+    wire [7:0]  m_lock;
+    wire [7:0]  m_smp;
+    wire [95:0] m_pos;
+
+    ppmsum ppmsum_00(.clk(clk),         .ppm(ppm[sum_pin]),
+        .lock(m_lock),                  .smp(m_smp),
+        .pos(m_pos)
+    );
+
+    wire [95:0] pos = sum_en ? m_pos : {{6{12'd2048}}, s_pos};
+    assign lock     = sum_en ? m_lock : {6'h0, s_lock};
+    assign smp      = sum_en ? m_smp : {6'h0, s_smp};
+
+    /* Capture timestamps and new sample flags */
+    reg [127:0] ts;
+    reg [7:0]   fresh = 8'h0;
+    wire [7:0]  clr = (rd && adr[3]) ? (8'h1 << adr[2:0]) : 8'h0;
+
+    genvar k;
+    generate
+        for (k = 0; k < 8; k = k + 1) begin : chan
+            assign mag[8*k +: 8] = pos[12*k + 4 +: 8];
+            always @(posedge clk) begin
+                if (smp[k])
+                    ts[16*k +: 16] <= us;
+            end
+        end
+    endgenerate
+
+    always @(posedge clk)
+        fresh <= (fresh & ~clr) | smp;
+
+    wire [2:0]  c = adr[2:0];
+    wire [31:0] rdt_ch = {ts[16*c +: 16], fresh[c], lock[c], 2'h0, pos[12*c +: 12]};
+
+    assign rdt = adr[3]        ? rdt_ch :
+                 (adr == 4'h0) ? {30'h0, ctl} :
+                 (adr == 4'h1) ? {16'h0, lock, fresh} : 32'h0;
+
+endmodule
@@ -2,10 +2,12 @@
 
 `default_nettype wire
 module ppmi (
-    input clk,           /* 50MHz input */
-    input ppm,           /* R/C servo receiver input */
-    output reg lock,     /* has signal lock */
-    output reg [7:0] mag /* 0-255 position value */
+    input clk,              /* 50MHz input */
+    input ppm,              /* R/C servo receiver input */
+    output reg lock,        /* has signal lock */
+    output reg smp,         /* pulses with each new mag value */
+    output reg [7:0] mag,   /* 0-255 position value */
+    output reg [11:0] pos   /* 0-4095 position value, mag plus 4 bits */
 );
 
     parameter [1:0] state_idle  = 2'b00;
@@ -23,6 +25,12 @@ module ppmi (
     wire err = &acc;
     wire tck = (div == 8'd195);
 
+    /*
+     * Clocks since the last tick in 1/16ths of a tick, div * 16 / 196 is
+     * close enough to div * 21 / 256 and stays within 0 - 15.
+     */
+    wire [12:0] fine = {5'h0, div} * 13'd21;
+
     always @(posedge clk) begin
         pps <= {pps[1:0], ppm};
         div <= (pps_up | pps_dn | tck) ? 8'h0 : div + 1;
@@ -33,6 +41,7 @@ module ppmi (
     end
 
     always @(posedge clk) begin
+        smp <= 1'b0;
 
         if (err)
             state <= state_idle;
@@ -42,6 +51,7 @@ module ppmi (
                 state_idle: begin
                     lock <= 1'b0;
                     mag  <= 8'd128;
+                    pos  <= 12'd2048;
                     if (pps_up)
                         state <= state_acc;
                 end
@@ -55,7 +65,9 @@ module ppmi (
                         /* pulse width must be between 1 & 2 mS */
                         if (acc[12:8] == 5'h1) begin
                             lock  <= 1'b1;
+                            smp   <= 1'b1;
                             mag   <= acc[7:0];
+                            pos   <= {acc[7:0], fine[11:8]};
                             state <= state_blank;
                         end else begin
                             state <= state_idle;
@@ -72,6 +84,8 @@ module ppmi (
                         state <= state_acc;
                 end
 
+                default:
+                    state <= state_idle;
             endcase
         end
     end
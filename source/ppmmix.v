@@ -0,0 +1,97 @@
+/* SPDX-License-Identifier: [MIT] */
+
+`default_nettype wire
+
+/*
+ * PPM to PWM mixer. Each pcpwm channel can follow a ppmi input, every new
+ * sample from that input is scaled and written to the channel without the
+ * CPU. A channel takes the magnitude on one side of the 128 center, so a
+ * full bridge is two channels on the same input, one per side.
+ *
+ * Config, one word per channel:
+ *  [0]=enable, [1]=reverse side (input below center)
+ *  [6:4]=ppmi input
+ *  [15:8]=deadband, inputs closer than this to the center give 0
+ *  [27:16]=gain, Q4.8, the scaled magnitude is clamped to 255
+ *
+ * A sample starts a pass over all 8 channels, one channel per clock. The
+ * results are written to the pcpwm channels together at the end of the
+ * pass, so both sides of a bridge change at the same turnaround. Firmware
+ * writes to a channel still land, they hold until the next sample.
+ */
+module ppmmix #(
+    parameter INPUTS = 2
+)(
+    input           clk,
+
+    /* Config registers */
+    input           we,
+    input   [2:0]   ch,
+    input   [3:0]   sel,
+    input   [31:0]  dat,
+    output  [31:0]  rdt,
+
+    /* ppmi inputs, 8 bits per input */
+    input   [INPUTS-1:0]    smp,    /* new sample */
+    input   [8*INPUTS-1:0]  mag,
+
+    /* pcpwm channel writes, 8 bits per channel */
+    output reg  [7:0]   we_pwm,
+    output reg  [63:0]  pwm
+);
+
+    reg [255:0] cfg = 256'h0;
+    assign rdt = cfg[32*ch +: 32];
+
+    always @(posedge clk) begin
+        if (we) begin
+            if (sel[0]) cfg[32*ch +: 8]      <= dat[7:0];
+            if (sel[1]) cfg[32*ch + 8 +: 8]  <= dat[15:8];
+            if (sel[2]) cfg[32*ch + 16 +: 8] <= dat[23:16];
+            if (sel[3]) cfg[32*ch + 24 +: 8] <= dat[31:24];
+        end
+    end
+
+    /* Inputs with a sample waiting, and the ones in the current pass */
+    reg [INPUTS-1:0] pend = 0;
+    reg [INPUTS-1:0] cur = 0;
+    reg [7:0]        upd;
+    reg [3:0]        step;
+    reg              busy = 1'b0;
+
+    /* Channel 'step' of the pass */
+    wire [31:0] c     = cfg[32*step[2:0] +: 32];
+    wire [7:0]  cur8  = cur;
+    wire [63:0] mag8  = mag;
+    wire [7:0]  v     = mag8[8*c[6:4] +: 8];
+    wire        side  = c[1] ? (v < 8'd128) : (v >= 8'd128);
+    wire [7:0]  m     = c[1] ? 8'd128 - v : v - 8'd128;
+    wire [19:0] prod  = m * c[27:16];
+    wire [7:0]  q     = (!side || (m < c[15:8])) ? 8'h0 :
+                        (|prod[19:16]) ? 8'hff : prod[15:8];
+
+    always @(posedge clk) begin
+        we_pwm <= 8'h0;
+        pend   <= pend | smp;
+
+        if (!busy) begin
+            if (|pend) begin
+                cur  <= pend;
+                pend <= smp;
+                upd  <= 8'h0;
+                step <= 4'h0;
+                busy <= 1'b1;
+            end
+        end else if (step[3]) begin
+            we_pwm <= upd;
+            busy   <= 1'b0;
+        end else begin
+            if (c[0] && cur8[c[6:4]]) begin
+                pwm[8*step[2:0] +: 8] <= q;
+                upd[step[2:0]]        <= 1'b1;
+            end
+            step <= step + 4'h1;
+        end
+    end
+
+endmodule
@@ -0,0 +1,69 @@
+/* SPDX-License-Identifier: [MIT] */
+
+`default_nettype wire
+
+/*
+ * PPM-sum decoder, up to 8 R/C channels on one wire. Each channel is the
+ * time between two rising edges, 1 - 2mS, and a gap of 3mS or more starts
+ * the next frame. Positions are measured as in ppmi, a channel outside of
+ * 1 - 2mS drops the rest of the frame. Channels the receiver doesn't send
+ * never lock, 32mS without an edge unlocks them all.
+ */
+module ppmsum (
+    input clk,              /* 50MHz input */
+    input ppm,              /* R/C receiver PPM-sum input */
+    output reg [7:0] lock,  /* has signal lock, per channel */
+    output reg [7:0] smp,   /* pulses with each new pos value */
+    output reg [95:0] pos   /* 0-4095 position values, 12 bits per channel */
+);
+
+    localparam [12:0] SYNC = 13'd765;  /* 3mS in ticks */
+
+    reg [2:0] pps; /* syncronization register */
+    wire pps_up = (pps[2:1] == 2'b01);
+
+    reg [7:0]  div; /* clock divider */
+    reg [12:0] acc; /* ticks since the last rising edge, saturates */
+    wire err = &acc;
+    wire tck = (div == 8'd195);
+    wire [12:0] fine = {5'h0, div} * 13'd21;
+
+    /* Channel the next edge ends, 8 while waiting for the frame sync */
+    reg [3:0] idx = 4'h8;
+
+    initial begin
+        lock = 8'h0;
+        pos  = {8{12'd2048}};
+    end
+
+    always @(posedge clk) begin
+        pps <= {pps[1:0], ppm};
+        div <= (pps_up | tck) ? 8'h0 : div + 1;
+        if (pps_up)
+            acc <= 0;
+        else if (tck && !err)
+            acc <= acc + 1;
+    end
+
+    always @(posedge clk) begin
+        smp <= 8'h0;
+
+        if (err) begin
+            lock <= 8'h0;
+            pos  <= {8{12'd2048}};
+            idx  <= 4'h8;
+        end else if (pps_up) begin
+            if (acc >= SYNC) begin
+                idx <= 4'h0;
+            end else if (!idx[3] && (acc[12:8] == 5'h1)) begin
+                lock[idx[2:0]] <= 1'b1;
+                smp[idx[2:0]]  <= 1'b1;
+                pos[12*idx[2:0] +: 12] <= {acc[7:0], fine[11:8]};
+                idx <= idx + 4'h1;
+            end else begin
+                idx <= 4'h8;
+            end
+        end
+    end
+
+endmodule
@@ -2,7 +2,9 @@
 
 `default_nettype wire
 
-module soc(
+module soc #(
+    parameter HARTS = 2     /* SERV harts, 2 - 8 */
+)(
     input   clk,
     output [7:0] led, // Indicators | LEDs
     input  [7:0] gpi,
@@ -21,30 +23,34 @@ module soc(
     output  [7:0] ppmo,
 
     output  [7:0] pwmo,
-    output  trigger
+    output  trigger,
+
+    // BS62LV1027SC-70, 128KB external SRAM
+    output          sr_cs,
+    output          sr_we,
+    output          sr_oe,
+    output  [16:0]  sr_adr,
+    inout   [7:0]   sr_dio
 );
     
     
+    /*
+     * Bus masters, the harts, then the SPI slave, CRC and DMA engines and
+     * the telemetry sampler
+     */
+    localparam MASTERS = HARTS + 4;
+
     ////////////////////////////
     // BUS Mux
-    // CPU Interface
-    wire            wb_cpu_cyc;
-    wire            wb_cpu_stb;
-    wire            wb_cpu_we;
-    wire            wb_cpu_ack;
-    wire    [3:0]   wb_cpu_sel;
-    wire    [31:0]  wb_cpu_adr;
-    wire    [31:0]  wb_cpu_dat;
-    wire    [31:0]  wb_cpu_rdt;
-    // AUX Interface
-    wire            wb_aux_cyc;
-    wire            wb_aux_stb;
-    wire            wb_aux_we;
-    wire            wb_aux_ack;
-    wire    [3:0]   wb_aux_sel;
-    wire    [31:0]  wb_aux_adr;
-    wire    [31:0]  wb_aux_dat;
-    wire    [31:0]  wb_aux_rdt;
+    // Hart Interfaces, hart N uses bit N, nibble N or word N
+    wire    [HARTS-1:0]     wb_hrt_cyc;
+    wire    [HARTS-1:0]     wb_hrt_stb;
+    wire    [HARTS-1:0]     wb_hrt_we;
+    wire    [HARTS-1:0]     wb_hrt_ack;
+    wire    [4*HARTS-1:0]   wb_hrt_sel;
+    wire    [32*HARTS-1:0]  wb_hrt_adr;
+    wire    [32*HARTS-1:0]  wb_hrt_dat;
+    wire    [32*HARTS-1:0]  wb_hrt_rdt;
     /* SPI Interface */
     wire            wb_spi_cyc;
     wire            wb_spi_stb;
@@ -54,6 +60,27 @@ module soc(
     wire    [31:0]  wb_spi_adr;
     wire    [31:0]  wb_spi_dat;
     wire    [31:0]  wb_spi_rdt;
+    /* CRC engine Interface, read only */
+    wire            wb_crm_cyc;
+    wire            wb_crm_stb;
+    wire            wb_crm_ack;
+    wire    [31:0]  wb_crm_adr;
+    wire    [31:0]  wb_crm_rdt;
+    /* DMA engine Interface */
+    wire            wb_dmm_cyc;
+    wire            wb_dmm_stb;
+    wire            wb_dmm_we;
+    wire            wb_dmm_ack;
+    wire    [31:0]  wb_dmm_adr;
+    wire    [31:0]  wb_dmm_dat;
+    wire    [31:0]  wb_dmm_rdt;
+    /* Telemetry sampler Interface, writes only */
+    wire            wb_smm_cyc;
+    wire            wb_smm_stb;
+    wire            wb_smm_we;
+    wire            wb_smm_ack;
+    wire    [31:0]  wb_smm_adr;
+    wire    [31:0]  wb_smm_dat;
     /* BUS Interface */
     wire            wb_bus_cyc;
     wire            wb_bus_stb;
@@ -64,7 +91,7 @@ module soc(
     wire    [31:0]  wb_bus_dat;
     wire    [31:0]  wb_bus_rdt;
 
-    wire    [3:0]   busid;
+    wire    [MASTERS-1:0]   busid;
     // BUS Mux
     ////////////////////////////
 
@@ -80,6 +107,76 @@ module soc(
     wire    [31:0]  wb_mem_rdt;
     // Block RAM
     ///////////////////////////
+
+    ////////////////////////////
+    // External SRAM
+    wire            wb_srm_cyc  = wb_bus_cyc;
+    wire            wb_srm_stb;
+    wire            wb_srm_we   = wb_bus_we;
+    wire            wb_srm_ack;
+    wire    [3:0]   wb_srm_sel  = wb_bus_sel;
+    wire    [31:0]  wb_srm_adr  = wb_bus_adr;
+    wire    [31:0]  wb_srm_dat  = wb_bus_dat;
+    wire    [31:0]  wb_srm_rdt;
+
+    // Cache to SRAM
+    wire            wb_scm_cyc;
+    wire            wb_scm_stb;
+    wire            wb_scm_we;
+    wire            wb_scm_ack;
+    wire    [3:0]   wb_scm_sel;
+    wire    [16:0]  wb_scm_adr;
+    wire    [31:0]  wb_scm_dat;
+    wire    [31:0]  wb_scm_rdt;
+    // External SRAM
+    ///////////////////////////
+
+    ////////////////////////////
+    // Hart path split. Block RAM cycles from hart 0 use RAM port A, mailbox
+    // cycles from harts 0 and 1 go to the hart's own mailbox port, the rest
+    // go through bussel. All other masters reach the RAM through port B.
+    wire    [HARTS-1:0]     hrt_mem;
+    wire    [HARTS-1:0]     hrt_mbx;
+    wire            wb_cpm_cyc  = wb_hrt_cyc[0] & hrt_mem[0];
+    wire            wb_cpm_stb  = wb_hrt_stb[0] & hrt_mem[0];
+    wire            wb_cpm_we   = wb_hrt_we[0];
+    wire            wb_cpm_ack;
+    wire    [3:0]   wb_cpm_sel  = wb_hrt_sel[3:0];
+    wire    [31:0]  wb_cpm_adr  = wb_hrt_adr[31:0];
+    wire    [31:0]  wb_cpm_dat  = wb_hrt_dat[31:0];
+    wire    [31:0]  wb_cpm_rdt;
+    wire    [HARTS-1:0]     wb_mbx_ack;
+    wire    [32*HARTS-1:0]  wb_mbx_rdt;
+    wire    [HARTS-1:0]     wb_hrb_cyc  = wb_hrt_cyc & ~hrt_mem & ~hrt_mbx;
+    wire    [HARTS-1:0]     wb_hrb_stb  = wb_hrt_stb & ~hrt_mem & ~hrt_mbx;
+    wire    [HARTS-1:0]     wb_hrb_ack;
+
+    genvar h;
+    generate
+        for (h = 0; h < HARTS; h = h + 1) begin : split
+            wire [31:0] adr = wb_hrt_adr[32*h +: 32];
+
+            if (h == 0)
+                assign hrt_mem[h] = (adr[23:22] == 2'b0);
+            else
+                assign hrt_mem[h] = 1'b0;
+
+            if (h < 2) begin
+                assign hrt_mbx[h] = (adr[23:22] == 2'b11) && (adr[19:16] == 4'h5);
+            end else begin
+                assign hrt_mbx[h] = 1'b0;
+                assign wb_mbx_ack[h] = 1'b0;
+                assign wb_mbx_rdt[32*h +: 32] = 32'h0;
+            end
+
+            assign wb_hrt_ack[h] = hrt_mem[h] ? wb_cpm_ack :
+                                        hrt_mbx[h] ? wb_mbx_ack[h] : wb_hrb_ack[h];
+            assign wb_hrt_rdt[32*h +: 32] = hrt_mem[h] ? wb_cpm_rdt :
+                                        hrt_mbx[h] ? wb_mbx_rdt[32*h +: 32] : wb_bus_rdt;
+        end
+    endgenerate
+    // Hart path split
+    ///////////////////////////
     
     ////////////////////////////
     // General Purpose I/O Block
@@ -92,45 +189,147 @@ module soc(
     wire    [31:0]  wb_gio_dat  = wb_bus_dat;
     wire    [31:0]  wb_gio_rdt;
     wire    [7:0]   gio_q;
+    wire    [HARTS+7:0] gio_hart = {8'h0, busid[HARTS-1:0]};
     // General Purpose I/O Block
     ///////////////////////////
-    assign led[5:0] = ~gio_q;
+    
+    ////////////////////////////
+    // CRC32 engine registers
+    wire            wb_crc_cyc  = wb_bus_cyc;
+    wire            wb_crc_stb;
+    wire            wb_crc_we   = wb_bus_we;
+    wire            wb_crc_ack;
+    wire    [31:0]  wb_crc_adr  = wb_bus_adr;
+    wire    [31:0]  wb_crc_dat  = wb_bus_dat;
+    wire    [31:0]  wb_crc_rdt;
+    // CRC32 engine registers
+    ///////////////////////////
+
+    ////////////////////////////
+    // Telemetry sampler
+    wire            wb_smp_cyc  = wb_bus_cyc;
+    wire            wb_smp_stb;
+    wire            wb_smp_we   = wb_bus_we;
+    wire            wb_smp_ack;
+    wire    [31:0]  wb_smp_adr  = wb_bus_adr;
+    wire    [31:0]  wb_smp_dat  = wb_bus_dat;
+    wire    [31:0]  wb_smp_rdt;
+    wire    [223:0] gio_tlm;
+    // Telemetry sampler
+    ///////////////////////////
+
+    ////////////////////////////
+    // Bus arbiter statistics
+    wire            wb_arb_cyc  = wb_bus_cyc;
+    wire            wb_arb_stb;
+    wire            wb_arb_we   = wb_bus_we;
+    wire            wb_arb_ack;
+    wire    [31:0]  wb_arb_adr  = wb_bus_adr;
+    wire    [31:0]  wb_arb_dat  = wb_bus_dat;
+    wire    [31:0]  wb_arb_rdt;
+    // Bus arbiter statistics
+    ///////////////////////////
+
+    ////////////////////////////
+    // Performance counters
+    wire            wb_prf_cyc  = wb_bus_cyc;
+    wire            wb_prf_stb;
+    wire            wb_prf_we   = wb_bus_we;
+    wire            wb_prf_ack;
+    wire    [31:0]  wb_prf_adr  = wb_bus_adr;
+    wire    [31:0]  wb_prf_dat  = wb_bus_dat;
+    wire    [31:0]  wb_prf_rdt;
+    wire    [HARTS-1:0] ev_ibus_cyc;
+    wire    [HARTS-1:0] ev_ibus_ack;
+    wire    [HARTS-1:0] ev_dbus_cyc;
+    // Performance counters
+    ///////////////////////////
+
+    ////////////////////////////
+    // Hardware locks
+    wire            wb_hwl_cyc  = wb_bus_cyc;
+    wire            wb_hwl_stb;
+    wire            wb_hwl_we   = wb_bus_we;
+    wire            wb_hwl_ack;
+    wire    [31:0]  wb_hwl_adr  = wb_bus_adr;
+    wire    [31:0]  wb_hwl_dat  = wb_bus_dat;
+    wire    [31:0]  wb_hwl_rdt;
+    // Hardware locks
+    ///////////////////////////
+
+    ////////////////////////////
+    // Hart timers
+    wire            wb_tmr_cyc  = wb_bus_cyc;
+    wire            wb_tmr_stb;
+    wire            wb_tmr_we   = wb_bus_we;
+    wire            wb_tmr_ack;
+    wire    [31:0]  wb_tmr_adr  = wb_bus_adr;
+    wire    [31:0]  wb_tmr_dat  = wb_bus_dat;
+    wire    [31:0]  wb_tmr_rdt;
+    wire    [HARTS-1:0] tmr_irq;
+    wire    [31:0]  tmr_us;
+    // Hart timers
+    ///////////////////////////
+
+    ////////////////////////////
+    // SRAM cache control
+    wire            wb_sch_cyc  = wb_bus_cyc;
+    wire            wb_sch_stb;
+    wire            wb_sch_we   = wb_bus_we;
+    wire            wb_sch_ack;
+    wire    [31:0]  wb_sch_adr  = wb_bus_adr;
+    wire    [31:0]  wb_sch_dat  = wb_bus_dat;
+    wire    [31:0]  wb_sch_rdt;
+    // SRAM cache control
+    ///////////////////////////
+
+    ////////////////////////////
+    // DMA engine control
+    wire            wb_dma_cyc  = wb_bus_cyc;
+    wire            wb_dma_stb;
+    wire            wb_dma_we   = wb_bus_we;
+    wire            wb_dma_ack;
+    wire    [31:0]  wb_dma_adr  = wb_bus_adr;
+    wire    [31:0]  wb_dma_dat  = wb_bus_dat;
+    wire    [31:0]  wb_dma_rdt;
+    // DMA engine control
+    ///////////////////////////
+    assign led[5:0] = ~gio_q[5:0];
     assign edrive = gio_q[7];
     
 
     /*
      * This is set in a write-only register settable by the SPI master.
-     * It's used to hold the CPU in reset or not.
+     * It's used to hold the CPU in reset or not, one bit per hart.
      */
-    reg [1:0] cpu_reset = 2'b11;
+    reg [HARTS-1:0] cpu_reset = {HARTS{1'b1}};
     assign led[7] = ~cpu_reset[0];
     assign led[6] = ~cpu_reset[1];
     wire cpu_reset_stb = (wb_spi_adr[20] == 1'b1) && wb_spi_cyc;
     
     always @ (posedge clk) begin
-        cpu_reset <= (cpu_reset_stb & wb_spi_we) ? wb_spi_dat[1:0] : cpu_reset;           
+        cpu_reset <= (cpu_reset_stb & wb_spi_we) ? wb_spi_dat[HARTS-1:0] : cpu_reset;           
     end
 
 
-    /* CPU0 - A SERV RISC-V CPU implemented with single wishbone bus master interface */
-    wb_servant cpu (
-        .wb_clk(clk),
-        .wb_rst(cpu_reset[0]),
-
-        .wb_cpu_cyc(wb_cpu_cyc),    .wb_cpu_stb(wb_cpu_stb),    .wb_cpu_we(wb_cpu_we),
-        .wb_cpu_ack(wb_cpu_ack),    .wb_cpu_sel(wb_cpu_sel),    .wb_cpu_adr(wb_cpu_adr),
-        .wb_cpu_dat(wb_cpu_dat),    .wb_cpu_rdt(wb_cpu_rdt)
-    );
+    /* SERV RISC-V harts, each implemented with a single wishbone bus master interface */
+    generate
+        for (h = 0; h < HARTS; h = h + 1) begin : hart
+            wb_servant cpu (
+                .wb_clk(clk),
+                .wb_rst(cpu_reset[h]),
+                .timer_irq(tmr_irq[h]),
 
-    /* CPU1 - Another SERV RISC-V CPU */
-    wb_servant aux (
-        .wb_clk(clk),
-        .wb_rst(cpu_reset[1]),
+                .wb_cpu_cyc(wb_hrt_cyc[h]),             .wb_cpu_stb(wb_hrt_stb[h]),
+                .wb_cpu_we(wb_hrt_we[h]),               .wb_cpu_ack(wb_hrt_ack[h]),
+                .wb_cpu_sel(wb_hrt_sel[4*h +: 4]),      .wb_cpu_adr(wb_hrt_adr[32*h +: 32]),
+                .wb_cpu_dat(wb_hrt_dat[32*h +: 32]),    .wb_cpu_rdt(wb_hrt_rdt[32*h +: 32]),
 
-        .wb_cpu_cyc(wb_aux_cyc),    .wb_cpu_stb(wb_aux_stb),    .wb_cpu_we(wb_aux_we),
-        .wb_cpu_ack(wb_aux_ack),    .wb_cpu_sel(wb_aux_sel),    .wb_cpu_adr(wb_aux_adr),
-        .wb_cpu_dat(wb_aux_dat),    .wb_cpu_rdt(wb_aux_rdt)
-    );
+                .ev_ibus_cyc(ev_ibus_cyc[h]), .ev_ibus_ack(ev_ibus_ack[h]),
+                .ev_dbus_cyc(ev_dbus_cyc[h])
+            );
+        end
+    endgenerate
 
     /*
      * SPI Slave to Wishbone Master, this can only address bits [23:0]
@@ -142,42 +341,195 @@ module soc(
         .spi_mosi(spi_mosi),.spi_miso(spi_miso),
         
         .cyc_o(wb_spi_cyc), .stb_o(wb_spi_stb), .we_o(wb_spi_we),
-        .ack_i(wb_spi_ack), .sel_o(wb_spi_sel), .adr_o(wb_spi_adr),
+        .ack_i(wb_spi_ack), .sel_o(wb_spi_sel), .adr_o(wb_spi_adr[23:0]),
         .dat_o(wb_spi_dat), .dat_i(wb_spi_rdt)
     );
+    assign wb_spi_adr[31:24] = 8'h0;
     
-    /* XP2-5 Block RAM, 16384 bytes */
+    /* XP2-5 Block RAM, 18432 bytes, dual port */
     wb_bram bram (
         .clk(clk),
         .rst(1'b0),
-        
-        .cyc_i(wb_mem_cyc), .stb_i(wb_mem_stb), .we_i(wb_mem_we),
-        .ack_o(wb_mem_ack), .sel_i(wb_mem_sel), .adr_i(wb_mem_adr),
-        .dat_i(wb_mem_dat), .dat_o(wb_mem_rdt)
+
+        /* Port A, hart 0 only */
+        .a_cyc_i(wb_cpm_cyc), .a_stb_i(wb_cpm_stb), .a_we_i(wb_cpm_we),
+        .a_ack_o(wb_cpm_ack), .a_sel_i(wb_cpm_sel), .a_adr_i(wb_cpm_adr[14:0]),
+        .a_dat_i(wb_cpm_dat), .a_dat_o(wb_cpm_rdt),
+
+        /* Port B, shared bus */
+        .b_cyc_i(wb_mem_cyc), .b_stb_i(wb_mem_stb), .b_we_i(wb_mem_we),
+        .b_ack_o(wb_mem_ack), .b_sel_i(wb_mem_sel), .b_adr_i(wb_mem_adr[14:0]),
+        .b_dat_i(wb_mem_dat), .b_dat_o(wb_mem_rdt)
     );
-     
-    bussel bmux(
-        .clk(clk), .busid(busid),
-        /* CPU Interface */
-        .wb_cpu_cyc(wb_cpu_cyc),    .wb_cpu_stb(wb_cpu_stb),    .wb_cpu_we(wb_cpu_we),
-        .wb_cpu_ack(wb_cpu_ack),    .wb_cpu_sel(wb_cpu_sel),    .wb_cpu_adr(wb_cpu_adr),
-        .wb_cpu_dat(wb_cpu_dat),    .wb_cpu_rdt(wb_cpu_rdt),
 
-        /* AUX Interface */
-        .wb_aux_cyc(wb_aux_cyc),    .wb_aux_stb(wb_aux_stb),    .wb_aux_we(wb_aux_we),
-        .wb_aux_ack(wb_aux_ack),    .wb_aux_sel(wb_aux_sel),    .wb_aux_adr(wb_aux_adr),
-        .wb_aux_dat(wb_aux_dat),    .wb_aux_rdt(wb_aux_rdt),
+    /* Read cache in front of the SRAM, writes go through */
+    wb_sramcache scache (
+        .clk(clk),
+        .rst(1'b0),
+
+        .cyc_i(wb_srm_cyc), .stb_i(wb_srm_stb), .we_i(wb_srm_we),
+        .ack_o(wb_srm_ack), .sel_i(wb_srm_sel), .adr_i(wb_srm_adr[16:0]),
+        .dat_i(wb_srm_dat), .dat_o(wb_srm_rdt),
+
+        .c_cyc_i(wb_sch_cyc), .c_stb_i(wb_sch_stb), .c_we_i(wb_sch_we),
+        .c_ack_o(wb_sch_ack), .c_adr_i(wb_sch_adr[3:0]),
+        .c_dat_i(wb_sch_dat), .c_dat_o(wb_sch_rdt),
+
+        .m_cyc_o(wb_scm_cyc), .m_stb_o(wb_scm_stb), .m_we_o(wb_scm_we),
+        .m_ack_i(wb_scm_ack), .m_sel_o(wb_scm_sel), .m_adr_o(wb_scm_adr),
+        .m_dat_o(wb_scm_dat), .m_dat_i(wb_scm_rdt)
+    );
+
+    /* External SRAM, 131072 bytes on an 8 bit bus */
+    wb_sram sram (
+        .clk(clk),
+        .rst(1'b0),
+
+        .cyc_i(wb_scm_cyc), .stb_i(wb_scm_stb), .we_i(wb_scm_we),
+        .ack_o(wb_scm_ack), .sel_i(wb_scm_sel), .adr_i(wb_scm_adr),
+        .dat_i(wb_scm_dat), .dat_o(wb_scm_rdt),
+
+        .sr_cs(sr_cs),      .sr_we(sr_we),      .sr_oe(sr_oe),
+        .sr_adr(sr_adr),    .sr_dio(sr_dio)
+    );
+
+    /* CRC32 engine, used by the host to verify memory images */
+    wb_crc crc (
+        .clk(clk),
+        .rst(1'b0),
+
+        .cyc_i(wb_crc_cyc), .stb_i(wb_crc_stb), .we_i(wb_crc_we),
+        .ack_o(wb_crc_ack), .adr_i(wb_crc_adr[3:0]),
+        .dat_i(wb_crc_dat), .dat_o(wb_crc_rdt),
+
+        .m_cyc_o(wb_crm_cyc), .m_stb_o(wb_crm_stb), .m_ack_i(wb_crm_ack),
+        .m_adr_o(wb_crm_adr[23:0]), .m_dat_i(wb_crm_rdt)
+    );
+    assign wb_crm_adr[31:24] = 8'h0;
+
+    /* DMA engine, copy, fill and register write lists without a hart */
+    wb_dma dma (
+        .clk(clk),
+        .rst(1'b0),
 
-        /* SPI Interface */
-        .wb_spi_cyc(wb_spi_cyc),    .wb_spi_stb(wb_spi_stb),    .wb_spi_we(wb_spi_we),
-        .wb_spi_ack(wb_spi_ack),    .wb_spi_sel(wb_spi_sel),    .wb_spi_adr(wb_spi_adr),
-        .wb_spi_dat(wb_spi_dat),    .wb_spi_rdt(wb_spi_rdt),
+        .cyc_i(wb_dma_cyc), .stb_i(wb_dma_stb), .we_i(wb_dma_we),
+        .ack_o(wb_dma_ack), .adr_i(wb_dma_adr[4:0]),
+        .dat_i(wb_dma_dat), .dat_o(wb_dma_rdt),
+
+        .m_cyc_o(wb_dmm_cyc), .m_stb_o(wb_dmm_stb), .m_we_o(wb_dmm_we),
+        .m_ack_i(wb_dmm_ack), .m_adr_o(wb_dmm_adr[23:0]),
+        .m_dat_o(wb_dmm_dat), .m_dat_i(wb_dmm_rdt)
+    );
+    assign wb_dmm_adr[31:24] = 8'h0;
+
+    /* Telemetry sampler, snapshots gio registers into a ring buffer in SRAM */
+    wb_sampler smp (
+        .clk(clk),
+        .rst(1'b0),
+
+        .cyc_i(wb_smp_cyc), .stb_i(wb_smp_stb), .we_i(wb_smp_we),
+        .ack_o(wb_smp_ack), .adr_i(wb_smp_adr[4:0]),
+        .dat_i(wb_smp_dat), .dat_o(wb_smp_rdt),
+
+        .m_cyc_o(wb_smm_cyc), .m_stb_o(wb_smm_stb), .m_we_o(wb_smm_we),
+        .m_ack_i(wb_smm_ack), .m_adr_o(wb_smm_adr[23:0]),
+        .m_dat_o(wb_smm_dat),
+
+        .tlm(gio_tlm)
+    );
+    assign wb_smm_adr[31:24] = 8'h0;
+
+    /* Bus arbiter statistics, grants and wait cycles per bus master */
+    wb_arbstat #(.MASTERS(MASTERS)) arb (
+        .clk(clk),
+        .rst(1'b0),
+
+        .cyc_i(wb_arb_cyc), .stb_i(wb_arb_stb), .we_i(wb_arb_we),
+        .ack_o(wb_arb_ack), .adr_i(wb_arb_adr[7:0]),
+        .dat_i(wb_arb_dat), .dat_o(wb_arb_rdt),
+
+        .req({wb_smm_cyc, wb_dmm_cyc, wb_crm_cyc, wb_spi_cyc, wb_hrb_cyc}),
+        .gnt(busid), .bus_ack(wb_bus_ack)
+    );
+
+    /* Performance counters, per hart and for the SPI slave */
+    wb_perf #(.HARTS(HARTS)) prf (
+        .clk(clk),
+        .rst(1'b0),
+
+        .cyc_i(wb_prf_cyc), .stb_i(wb_prf_stb), .we_i(wb_prf_we),
+        .ack_o(wb_prf_ack), .adr_i(wb_prf_adr[8:0]),
+        .dat_i(wb_prf_dat), .dat_o(wb_prf_rdt),
+
+        .hart_run(~cpu_reset),
+        .ibus_cyc(ev_ibus_cyc), .ibus_ack(ev_ibus_ack), .dbus_cyc(ev_dbus_cyc),
+        .bus_wait(wb_hrb_cyc & ~busid[HARTS-1:0]),
+
+        .spi_ack(wb_spi_ack), .spi_wait(wb_spi_cyc & ~busid[HARTS])
+    );
+
+    /* Hardware locks, test-and-set registers shared by all bus masters */
+    wb_hwlock #(.HARTS(HARTS), .MASTERS(MASTERS)) hwl (
+        .clk(clk),
+        .rst(1'b0),
+
+        .cyc_i(wb_hwl_cyc), .stb_i(wb_hwl_stb), .we_i(wb_hwl_we),
+        .ack_o(wb_hwl_ack), .adr_i(wb_hwl_adr[7:0]),
+        .dat_i(wb_hwl_dat), .dat_o(wb_hwl_rdt),
+
+        .busid(busid), .hart_rst(cpu_reset)
+    );
+
+    /* Compare-match timers, the SERV timer interrupt of each hart */
+    wb_timer #(.HARTS(HARTS), .MASTERS(MASTERS)) tmr (
+        .clk(clk),
+        .rst(1'b0),
+
+        .cyc_i(wb_tmr_cyc), .stb_i(wb_tmr_stb), .we_i(wb_tmr_we),
+        .ack_o(wb_tmr_ack), .adr_i(wb_tmr_adr[7:0]),
+        .dat_i(wb_tmr_dat), .dat_o(wb_tmr_rdt),
+
+        .busid(busid), .irq(tmr_irq), .us_o(tmr_us)
+    );
+
+    /* Mailboxes between the harts, each hart has a private port */
+    wb_mailbox mbx (
+        .clk(clk),
+        .rst(cpu_reset[0] | cpu_reset[1]),
+
+        /* Port A, hart 0 */
+        .a_cyc_i(wb_hrt_cyc[0] & hrt_mbx[0]), .a_stb_i(wb_hrt_stb[0] & hrt_mbx[0]),
+        .a_we_i(wb_hrt_we[0]),          .a_ack_o(wb_mbx_ack[0]),    .a_adr_i(wb_hrt_adr[3:0]),
+        .a_dat_i(wb_hrt_dat[31:0]),     .a_dat_o(wb_mbx_rdt[31:0]),
+
+        /* Port B, hart 1 */
+        .b_cyc_i(wb_hrt_cyc[1] & hrt_mbx[1]), .b_stb_i(wb_hrt_stb[1] & hrt_mbx[1]),
+        .b_we_i(wb_hrt_we[1]),          .b_ack_o(wb_mbx_ack[1]),    .b_adr_i(wb_hrt_adr[35:32]),
+        .b_dat_i(wb_hrt_dat[63:32]),    .b_dat_o(wb_mbx_rdt[63:32])
+    );
+     
+    /*
+     * Bus masters in busid order, the CRC engine only reads, the telemetry
+     * sampler only writes
+     */
+    bussel #(.MASTERS(MASTERS)) bmux(
+        .clk(clk), .busid(busid),
+        .m_cyc({wb_smm_cyc, wb_dmm_cyc, wb_crm_cyc, wb_spi_cyc, wb_hrb_cyc}),
+        .m_stb({wb_smm_stb, wb_dmm_stb, wb_crm_stb, wb_spi_stb, wb_hrb_stb}),
+        .m_we ({wb_smm_we,  wb_dmm_we,  1'b0,       wb_spi_we,  wb_hrt_we}),
+        .m_ack({wb_smm_ack, wb_dmm_ack, wb_crm_ack, wb_spi_ack, wb_hrb_ack}),
+        .m_sel({4'hf,       4'hf,       4'hf,       wb_spi_sel, wb_hrt_sel}),
+        .m_adr({wb_smm_adr, wb_dmm_adr, wb_crm_adr, wb_spi_adr, wb_hrt_adr}),
+        .m_dat({wb_smm_dat, wb_dmm_dat, 32'h0,      wb_spi_dat, wb_hrt_dat}),
 
         /* BUS Interface */
         .wb_bus_cyc(wb_bus_cyc),    .wb_bus_stb(wb_bus_stb),    .wb_bus_we(wb_bus_we),
         .wb_bus_ack(wb_bus_ack),    .wb_bus_sel(wb_bus_sel),    .wb_bus_adr(wb_bus_adr),
         .wb_bus_dat(wb_bus_dat),    .wb_bus_rdt(wb_bus_rdt)
     );
+    assign wb_spi_rdt = wb_bus_rdt;
+    assign wb_crm_rdt = wb_bus_rdt;
+    assign wb_dmm_rdt = wb_bus_rdt;
     
     buscon bcon(
         .wb_clk(clk),
@@ -186,8 +538,26 @@ module soc(
         .wb_bus_rdt(wb_bus_rdt),    .wb_bus_ack(wb_bus_ack),
         /* Block RAM interface. XP2-5 implements 16KB RAM */
         .wb_mem_stb(wb_mem_stb),    .wb_mem_rdt(wb_mem_rdt),    .wb_mem_ack(wb_mem_ack),
+        /* External SRAM interface, 128KB */
+        .wb_srm_stb(wb_srm_stb),    .wb_srm_rdt(wb_srm_rdt),    .wb_srm_ack(wb_srm_ack),
         /* General purpose I/O interface */
-        .wb_gio_stb(wb_gio_stb),    .wb_gio_rdt(wb_gio_rdt),    .wb_gio_ack(wb_gio_ack)
+        .wb_gio_stb(wb_gio_stb),    .wb_gio_rdt(wb_gio_rdt),    .wb_gio_ack(wb_gio_ack),
+        /* CRC32 engine interface */
+        .wb_crc_stb(wb_crc_stb),    .wb_crc_rdt(wb_crc_rdt),    .wb_crc_ack(wb_crc_ack),
+        /* Telemetry sampler interface */
+        .wb_smp_stb(wb_smp_stb),    .wb_smp_rdt(wb_smp_rdt),    .wb_smp_ack(wb_smp_ack),
+        /* Bus arbiter statistics interface */
+        .wb_arb_stb(wb_arb_stb),    .wb_arb_rdt(wb_arb_rdt),    .wb_arb_ack(wb_arb_ack),
+        /* Performance counter interface */
+        .wb_prf_stb(wb_prf_stb),    .wb_prf_rdt(wb_prf_rdt),    .wb_prf_ack(wb_prf_ack),
+        /* Hardware lock interface */
+        .wb_hwl_stb(wb_hwl_stb),    .wb_hwl_rdt(wb_hwl_rdt),    .wb_hwl_ack(wb_hwl_ack),
+        /* Hart timer interface */
+        .wb_tmr_stb(wb_tmr_stb),    .wb_tmr_rdt(wb_tmr_rdt),    .wb_tmr_ack(wb_tmr_ack),
+        /* SRAM cache control interface */
+        .wb_sch_stb(wb_sch_stb),    .wb_sch_rdt(wb_sch_rdt),    .wb_sch_ack(wb_sch_ack),
+        /* DMA engine control interface */
+        .wb_dma_stb(wb_dma_stb),    .wb_dma_rdt(wb_dma_rdt),    .wb_dma_ack(wb_dma_ack)
         /* Add more stuff as needed */
     );
     
@@ -199,58 +569,47 @@ module soc(
         .ppmi(ppmi),
         .ppmo(ppmo), .ppms(ppms),
    
-        .busid(busid), 
+        .hart(gio_hart[7:0]),
+        .us(tmr_us[15:0]),
         .wb_cyc(wb_gio_cyc),    .wb_stb(wb_gio_stb),    .wb_we(wb_gio_we),
-        .wb_sel(wb_gio_sel),    .wb_adr(wb_gio_adr),    .wb_dat(wb_gio_dat),
+        .wb_sel(wb_gio_sel),    .wb_adr(wb_gio_adr[7:0]), .wb_dat(wb_gio_dat),
         .wb_rdt(wb_gio_rdt),    .wb_ack(wb_gio_ack),
     
         .gpo(gio_q),
         .gpi(~gpi),
 
         /* I/O block stuff */
-        .pwmo(pwmo), .trig(trigger)
+        .pwmo(pwmo), .trig(trigger),
+
+        .tlm(gio_tlm)
     );
 
 endmodule
 
 
 /*
- * Select between the SPI Slave and CPU as the wishbone bus master
- * This arbitration happens automatically. The SPI slave may read or
- * write memory while the CPU is executing.
+ * Select between the wishbone bus masters, the harts, the SPI slave and the
+ * CRC engine. This arbitration happens automatically. The SPI slave may read
+ * or write memory while the CPU is executing. Masters take turns, so neither
+ * hart nor the SPI slave can starve the others, see wb_arbstat for the
+ * per master counters.
+ *
+ * Master N drives bit N of m_cyc, m_stb, m_we and m_ack, nibble N of m_sel
+ * and word N of m_adr and m_dat. All masters see wb_bus_rdt.
  */
-module bussel(
+module bussel #(
+    parameter MASTERS = 4
+)(
     input           clk,
     
-    /* CPU Interface */
-    input           wb_cpu_cyc,
-    input           wb_cpu_stb,
-    input           wb_cpu_we,
-    output          wb_cpu_ack,
-    input   [3:0]   wb_cpu_sel,
-    input   [31:0]  wb_cpu_adr,
-    input   [31:0]  wb_cpu_dat,
-    output  [31:0]  wb_cpu_rdt,
-
-    /* AUX Interface */
-    input           wb_aux_cyc,
-    input           wb_aux_stb,
-    input           wb_aux_we,
-    output          wb_aux_ack,
-    input   [3:0]   wb_aux_sel,
-    input   [31:0]  wb_aux_adr,
-    input   [31:0]  wb_aux_dat,
-    output  [31:0]  wb_aux_rdt,
-    
-    /* SPI Interface */
-    input           wb_spi_cyc,
-    input           wb_spi_stb,
-    input           wb_spi_we,
-    output          wb_spi_ack,
-    input   [3:0]   wb_spi_sel,
-    input   [31:0]  wb_spi_adr,
-    input   [31:0]  wb_spi_dat,
-    output  [31:0]  wb_spi_rdt,
+    /* Master Interfaces */
+    input   [MASTERS-1:0]       m_cyc,
+    input   [MASTERS-1:0]       m_stb,
+    input   [MASTERS-1:0]       m_we,
+    output  [MASTERS-1:0]       m_ack,
+    input   [4*MASTERS-1:0]     m_sel,
+    input   [32*MASTERS-1:0]    m_adr,
+    input   [32*MASTERS-1:0]    m_dat,
     
     /* BUS Interface */
     output          wb_bus_cyc,
@@ -263,84 +622,60 @@ module bussel(
     input   [31:0]  wb_bus_rdt,
 
     /* Grant Status (bus master ID) */
-    output  [3:0]   busid
+    output  [MASTERS-1:0]   busid
 );
 
-    parameter [3:0] state_gcpu  = 4'b0001;
-    parameter [3:0] state_gaux  = 4'b0010;
-    parameter [3:0] state_gspi  = 4'b0100;
-    parameter [3:0] state_idle  = 4'b1000;
-    
-    reg [3:0] state = state_idle;
-    wire grant_cpu = state[0];
-    wire grant_aux = state[1];
-    wire grant_spi = state[2];
-    assign busid   = state;
+    /* One-hot grant, all zero (idle) only after configuration */
+    reg [MASTERS-1:0] grant = 0;
 
-    wire cpu_cyc = wb_cpu_cyc & grant_cpu;
-    wire aux_cyc = wb_aux_cyc & grant_aux;
-    wire spi_cyc = wb_spi_cyc & grant_spi;
-
-    wire cpu_stb = wb_cpu_stb & grant_cpu;
-    wire aux_stb = wb_aux_stb & grant_aux;
-    wire spi_stb = wb_spi_stb & grant_spi;
+    /* The bus master reading this never sees the idle state */
+    assign busid = grant;
 
+    /*
+     * Round robin, in master order and from the last master back to
+     * master 0. When the master that holds the bus ends its cycle the grant
+     * goes straight to the next master in line with a cycle pending, there's
+     * no idle clock between masters. With nothing else pending the grant
+     * stays parked on the current master, which can then start its next
+     * cycle right away.
+     */
+    wire [MASTERS-1:0] req      = m_cyc;
+    wire [MASTERS-1:0] grant_up = grant << 1;
+    wire [MASTERS-1:0] after    = ~(grant_up - 1'b1);  /* masters past the grant */
+    wire [MASTERS-1:0] req_hi   = req & after;
+    wire [MASTERS-1:0] pick_hi  = req_hi & (~req_hi + 1'b1);
+    wire [MASTERS-1:0] pick_lo  = req & (~req + 1'b1);
+    wire [MASTERS-1:0] next     = |req_hi ? pick_hi : |req ? pick_lo : grant;
+
+    /* Never switch in the middle of a cycle */
     always @(posedge clk) begin
-        case (state)
-            state_idle: begin // Idle, waiting for transfer to start
-                state <= wb_cpu_cyc ? state_gcpu :
-                            wb_aux_cyc ? state_gaux :
-                                wb_spi_cyc ? state_gspi : state_idle;
-                end
-
-            state_gcpu: begin
-                state <= ~wb_cpu_cyc ? state_idle : state;
-                end
-
-            state_gaux: begin
-                state <= ~wb_aux_cyc ? state_idle : state;
-                end
-
-            state_gspi: begin
-                state <= ~wb_spi_cyc ? state_idle : state;
-                end
-
-            default:
-                state <= state_idle; 
-        endcase
+        grant <= |(req & grant) ? grant : next;
     end
-             
-    assign wb_bus_cyc = grant_cpu ? cpu_cyc :
-                            grant_aux ? aux_cyc : 
-                                grant_spi ? spi_cyc : 1'b0;
-
-    assign wb_bus_stb = grant_cpu ? cpu_stb :
-                            grant_aux ? aux_stb : 
-                                grant_spi ? spi_stb : 1'b0;
-
-    assign wb_bus_we  = grant_cpu ? wb_cpu_we :
-                            grant_aux ? wb_aux_we :
-                                grant_spi ? wb_spi_we : 1'b0;
-
-    assign wb_bus_sel = grant_cpu ? wb_cpu_sel :
-                            grant_aux ? wb_aux_sel :
-                                grant_spi ? wb_spi_sel : 1'b0;
-
-    assign wb_bus_adr = grant_cpu ? wb_cpu_adr :
-                            grant_aux ? wb_aux_adr :
-                                grant_spi ? wb_spi_adr : 0;
-
-    assign wb_bus_dat = grant_cpu ? wb_cpu_dat :
-                            grant_aux ? wb_aux_dat :
-                                grant_spi ? wb_spi_dat : 0;
-    
-    assign wb_cpu_rdt = wb_bus_rdt;
-    assign wb_aux_rdt = wb_bus_rdt;
-    assign wb_spi_rdt = wb_bus_rdt;
 
-    assign wb_cpu_ack = wb_bus_ack && grant_cpu;
-    assign wb_aux_ack = wb_bus_ack && grant_aux;
-    assign wb_spi_ack = wb_bus_ack && grant_spi;
+    reg  [3:0]  sel;
+    reg  [31:0] adr;
+    reg  [31:0] dat;
+
+    integer m;
+    always @(*) begin
+        sel = 4'h0;
+        adr = 32'h0;
+        dat = 32'h0;
+        for (m = 0; m < MASTERS; m = m + 1) begin
+            sel = sel | (m_sel[4*m +: 4]   & {4{grant[m]}});
+            adr = adr | (m_adr[32*m +: 32] & {32{grant[m]}});
+            dat = dat | (m_dat[32*m +: 32] & {32{grant[m]}});
+        end
+    end
+
+    assign wb_bus_cyc = |(m_cyc & grant);
+    assign wb_bus_stb = |(m_stb & grant);
+    assign wb_bus_we  = |(m_we & grant);
+    assign wb_bus_sel = sel;
+    assign wb_bus_adr = adr;
+    assign wb_bus_dat = dat;
+
+    assign m_ack = {MASTERS{wb_bus_ack}} & grant;
     
 endmodule
 
@@ -358,11 +693,56 @@ module buscon(
     output          wb_mem_stb,
     input   [31:0]  wb_mem_rdt,
     input           wb_mem_ack,
+
+    /* External SRAM interface, 128KB */
+    output          wb_srm_stb,
+    input   [31:0]  wb_srm_rdt,
+    input           wb_srm_ack,
     
     /* General purpose I/O interface */
     output          wb_gio_stb,
     input   [31:0]  wb_gio_rdt,
-    input           wb_gio_ack
+    input           wb_gio_ack,
+
+    /* CRC32 engine interface */
+    output          wb_crc_stb,
+    input   [31:0]  wb_crc_rdt,
+    input           wb_crc_ack,
+
+    /* Telemetry sampler interface */
+    output          wb_smp_stb,
+    input   [31:0]  wb_smp_rdt,
+    input           wb_smp_ack,
+
+    /* Bus arbiter statistics interface */
+    output          wb_arb_stb,
+    input   [31:0]  wb_arb_rdt,
+    input           wb_arb_ack,
+
+    /* Performance counter interface */
+    output          wb_prf_stb,
+    input   [31:0]  wb_prf_rdt,
+    input           wb_prf_ack,
+
+    /* Hardware lock interface */
+    output          wb_hwl_stb,
+    input   [31:0]  wb_hwl_rdt,
+    input           wb_hwl_ack,
+
+    /* Hart timer interface */
+    output          wb_tmr_stb,
+    input   [31:0]  wb_tmr_rdt,
+    input           wb_tmr_ack,
+
+    /* SRAM cache control interface */
+    output          wb_sch_stb,
+    input   [31:0]  wb_sch_rdt,
+    input           wb_sch_ack,
+
+    /* DMA engine control interface */
+    output          wb_dma_stb,
+    input   [31:0]  wb_dma_rdt,
+    input           wb_dma_ack
     
     /* TODO: Add more stuff */
 );
@@ -387,12 +767,64 @@ module buscon(
    */
     assign wb_mem_stb = (wb_bus_adr[23:22] == 2'b0) && wb_bus_cyc;
     assign wb_gio_stb = (wb_bus_adr[23:22] == 2'b1) && wb_bus_cyc;
+    assign wb_srm_stb = (wb_bus_adr[23:22] == 2'b10) && wb_bus_cyc;
+
+  /*
+   * The upper region is divided up into 64KB blocks for system peripherals.
+   *  0xC00000 = CRC32 engine
+   *  0xC10000 = Telemetry sampler
+   *  0xC20000 = Bus arbiter statistics
+   *  0xC30000 = Performance counters
+   *  0xC40000 = Hardware locks
+   *  0xC50000 = Mailboxes, hart ports only, acked here with 0xDEADDEAD
+   *  0xC60000 = Hart timers
+   *  0xC70000 = SRAM cache control
+   *  0xC80000 = DMA engine
+   */
+    wire   sys_sel    = (wb_bus_adr[23:22] == 2'b11);
+    assign wb_crc_stb = sys_sel && (wb_bus_adr[19:16] == 4'h0) && wb_bus_cyc;
+    assign wb_smp_stb = sys_sel && (wb_bus_adr[19:16] == 4'h1) && wb_bus_cyc;
+    assign wb_arb_stb = sys_sel && (wb_bus_adr[19:16] == 4'h2) && wb_bus_cyc;
+    assign wb_prf_stb = sys_sel && (wb_bus_adr[19:16] == 4'h3) && wb_bus_cyc;
+    assign wb_hwl_stb = sys_sel && (wb_bus_adr[19:16] == 4'h4) && wb_bus_cyc;
+    assign wb_tmr_stb = sys_sel && (wb_bus_adr[19:16] == 4'h6) && wb_bus_cyc;
+    assign wb_sch_stb = sys_sel && (wb_bus_adr[19:16] == 4'h7) && wb_bus_cyc;
+    assign wb_dma_stb = sys_sel && (wb_bus_adr[19:16] == 4'h8) && wb_bus_cyc;
+
+  /*
+   * Masters without a mailbox port (SPI, CRC, DMA, sampler, harts 2 and up)
+   * get an ack on the next clock instead of waiting forever, reads return
+   * 0xDEADDEAD.
+   */
+    wire   mbx_stb    = sys_sel && (wb_bus_adr[19:16] == 4'h5) && wb_bus_cyc;
+    reg    mbx_ack    = 1'b0;
+    always @ (posedge wb_clk)
+        mbx_ack <= mbx_stb && !mbx_ack;
  
     assign wb_bus_rdt = (wb_mem_stb) ? wb_mem_rdt :
-                        (wb_gio_stb) ? wb_gio_rdt : 32'hdeaddead;
+                        (wb_gio_stb) ? wb_gio_rdt :
+                        (wb_srm_stb) ? wb_srm_rdt :
+                        (wb_crc_stb) ? wb_crc_rdt :
+                        (wb_smp_stb) ? wb_smp_rdt :
+                        (wb_arb_stb) ? wb_arb_rdt :
+                        (wb_prf_stb) ? wb_prf_rdt :
+                        (wb_hwl_stb) ? wb_hwl_rdt :
+                        (wb_tmr_stb) ? wb_tmr_rdt :
+                        (wb_sch_stb) ? wb_sch_rdt :
+                        (wb_dma_stb) ? wb_dma_rdt : 32'hdeaddead;
 
     assign wb_bus_ack = (wb_mem_stb) ? wb_mem_ack :
-                        (wb_gio_stb) ? wb_gio_ack : 1'b0;
+                        (wb_gio_stb) ? wb_gio_ack :
+                        (wb_srm_stb) ? wb_srm_ack :
+                        (wb_crc_stb) ? wb_crc_ack :
+                        (wb_smp_stb) ? wb_smp_ack :
+                        (wb_arb_stb) ? wb_arb_ack :
+                        (wb_prf_stb) ? wb_prf_ack :
+                        (wb_hwl_stb) ? wb_hwl_ack :
+                        (mbx_stb)    ? mbx_ack :
+                        (wb_tmr_stb) ? wb_tmr_ack :
+                        (wb_sch_stb) ? wb_sch_ack :
+                        (wb_dma_stb) ? wb_dma_ack : 1'b0;
 
 endmodule
 
@@ -16,6 +16,13 @@ module spis(
 	output xfer_start, /* chip select falling edge */
 	output xfer_end, /* chip select rising edge */
 	output boundary, /* 32-bit boundary */
+
+	/*
+	 * Preset the bit counter on a boundary, the next boundary happens
+	 * after (32 - i_preset_cnt) bits. Used to insert read turnaround bytes.
+	 */
+	input        i_preset,
+	input  [5:0] i_preset_cnt,
 		
 	input         i_load, /* save i_data to internal holding register */
 	input  [31:0] i_data,
@@ -69,8 +76,10 @@ module spis(
 		 * Keep track of how many bits have been shifted. The bit counter will
 		 * pulse for 1 clock cycle on every word (4 byte) boundary. 
 		 */
-		if (spi_csn_dn || spi_boundary)
+		if (spi_csn_dn)
 			spi_bitcnt <= 6'h0;
+		else if (spi_boundary)
+			spi_bitcnt <= i_preset ? i_preset_cnt : 6'h0;
 		else if (spi_clk_up)
 			spi_bitcnt <= spi_bitcnt + 1;
 		
@@ -5,7 +5,17 @@
 
 // 32-bit wishbone interface to x8 sram
 // 2^17 bytes => 131,072 bytes --> 32768 4-byte words
-module wb_sram (
+//
+// Every byte takes BYTE_CLKS clocks on the external bus, derived from the
+// clock period and the sram access time. Writes only spend bus cycles on
+// the bytes with their select bit set. Reads always fetch the whole word
+// and keep streaming through the auto incremented address afterwards, so a
+// read of the next word is under way, or already buffered, when the bus
+// master asks for it.
+module wb_sram #(
+    parameter CLK_NS    = 20,   // system clock period
+    parameter ACCESS_NS = 70    // sram read access / write cycle time
+)(
     input               clk,    // 50MHz
     input               rst,
 
@@ -18,7 +28,7 @@ module wb_sram (
     input               cyc_i,
     input               stb_i,
     output reg          ack_o,
-    
+
     // BS62LV1027SC-70
     output reg          sr_cs,  // active low, 0 == selected
     output reg          sr_we,  // active low, 0 == write cycle, 1 == read cycle
@@ -27,45 +37,45 @@ module wb_sram (
     inout       [7:0]   sr_dio  // external bus data i/o
 );
 
-    parameter [7:0] st_idle    = 8'b00000001;
-    parameter [7:0] st_wait0   = 8'b00000010;
-    parameter [7:0] st_wait1   = 8'b00000100;
-    parameter [7:0] st_wait2   = 8'b00001000;
-    parameter [7:0] st_wait3   = 8'b00010000;
-    parameter [7:0] st_sample  = 8'b00100000;
-    parameter [7:0] st_ack     = 8'b01000000;
-    
-    reg [7:0] state;
+    // Clocks per byte. Enough whole clocks to cover the access time, plus
+    // one for the pad delays and data setup. A write byte has its write
+    // strobe low for all but the first and last of them, so at least 3.
+    localparam WAIT      = (ACCESS_NS + CLK_NS - 1) / CLK_NS;
+    localparam BYTE_CLKS = (WAIT + 1 < 3) ? 3 : WAIT + 1;
+
+    parameter [2:0] st_idle    = 3'b001;
+    parameter [2:0] st_read    = 3'b010;
+    parameter [2:0] st_write   = 3'b100;
+
+    reg [2:0] state = st_idle;
 
-    // is write cycle, if so (we == 1'b1)
-    wire do_xfer = cyc_i && stb_i;
-    wire do_write = we_i && cyc_i && stb_i;
-    wire do_read = ~we_i && cyc_i && stb_i;
+    // new wishbone cycle, not yet acked
+    wire do_xfer = cyc_i && stb_i && !ack_o;
 
 
     // auto incrementing byte address
     reg     [14:0]  word_adr;   // base word address
     reg     [1:0]   byte_off;   // byte offset within word
     assign  sr_adr = {word_adr, byte_off};  // composite byte address
- 
+
+    reg     [3:0]   cnt;        // clock within the byte cycle
+    wire            byte_end = (cnt == BYTE_CLKS - 1);
+
     reg     [31:0]  word_dat;   // sram return data
     assign  dat_o = word_dat;
+    reg     [23:0]  rd_dat;     // lower bytes of the word being read
+
+    // word_dat holds the sram word at buf_adr
+    reg     [14:0]  buf_adr;
+    reg             buf_ok = 1'b0;
 
     reg     [31:0]  word_out;   // sraw write data (wb --> sram)
+    reg     [3:0]   word_sel;   // write byte selects
     reg     [7:0]   byte_out;   //
-    reg             byte_drv;
+    reg             byte_drv = 1'b0;
 
-    reg             byte_sel;   // current byte select bit for write cycles
     assign sr_dio = byte_drv ? byte_out : 8'bzz;
 
-    // state machine control stuff..
-    wire last_byte = &byte_off; // currently working on 4th byte of external bus cycles?
-    wire read_sr_bus = (state == st_sample); // sample external bus data lines
-
-    always @ (posedge clk) begin
-        ack_o <= (state == st_sample) && last_byte && cyc_i && stb_i;
-    end
-
     // Mux the correct byte onto the 8-bit sram data bus for sram write cycle
     always @(*) begin
         case (byte_off)
@@ -76,102 +86,134 @@ module wb_sram (
         endcase
     end
 
-    // Mux out the byte select bit for 'this' sram write cycle
-    always @(*) begin
-        case (byte_off)
-            2'h0: byte_sel = sel_i[0];
-            2'h1: byte_sel = sel_i[1];
-            2'h2: byte_sel = sel_i[2];
-            2'h3: byte_sel = sel_i[3];
-        endcase
-    end
+    // First selected byte of a write, and the next one after byte_off.
+    // 4 when there's none.
+    function [2:0] first_sel(input [3:0] sel);
+        first_sel = sel[0] ? 3'h0 : sel[1] ? 3'h1 :
+                        sel[2] ? 3'h2 : sel[3] ? 3'h3 : 3'h4;
+    endfunction
 
-    // Read external bus data lines into the return data byte offset for sram
-    // read cycle
-    always @ (posedge clk) begin
-        if (read_sr_bus) begin
-            case (byte_off)
-                2'h0: word_dat[7:0]     <= sr_dio;
-                2'h1: word_dat[15:8]    <= sr_dio;
-                2'h2: word_dat[23:16]   <= sr_dio;
-                2'h3: word_dat[31:24]   <= sr_dio;
-            endcase
-        end
-    end
+    wire [2:0] wr_first = first_sel(sel_i);
+    wire [2:0] wr_next  = first_sel(word_sel & (4'he << byte_off));
+
+    // requests the current read stream or the buffer can answer
+    wire rd_hit  = do_xfer && !we_i && (adr_i[16:2] == word_adr);
+    wire buf_hit = do_xfer && !we_i && buf_ok && (adr_i[16:2] == buf_adr);
 
 
     always @ (posedge clk) begin
+        ack_o <= 1'b0;
+        cnt   <= byte_end ? 4'h0 : cnt + 4'h1;
+
+        case(state)
+            st_idle: begin
+                sr_cs <= 1'b1;
+                sr_we <= 1'b1;
+                sr_oe <= 1'b1;
+                byte_drv <= 1'b0;
+                cnt <= 4'h0;
+
+                if (buf_hit) begin
+                    // buffered by the read stream, carry on with the next
+                    ack_o <= 1'b1;
+                    {word_adr, byte_off} <= {buf_adr + 15'h1, 2'h0};
+                    sr_cs <= 1'b0;
+                    sr_oe <= 1'b0;
+                    state <= st_read;
+
+                end else if (do_xfer && !we_i) begin
+                    {word_adr, byte_off} <= {adr_i[16:2], 2'h0};
+                    sr_cs <= 1'b0;
+                    sr_oe <= 1'b0;
+                    state <= st_read;
+
+                end else if (do_xfer && wr_first[2]) begin
+                    // nothing selected, nothing to write
+                    ack_o <= 1'b1;
+
+                end else if (do_xfer) begin
+                    // sram controller drives bus on write cycles only!
+                    sr_cs <= 1'b0;
+                    byte_drv <= 1'b1;
+                    word_out <= dat_i;
+                    word_sel <= sel_i;
+                    {word_adr, byte_off} <= {adr_i[16:2], wr_first[1:0]};
+                    if (adr_i[16:2] == buf_adr)
+                        buf_ok <= 1'b0;
+                    state <= st_write;
+                end
+            end
 
-            case(state)
-                st_idle: begin
+            st_read: begin
+                if (do_xfer && !rd_hit && !buf_hit) begin
+                    // some other word or a write, stop the stream. Turn
+                    // the data bus around in idle first.
                     sr_cs <= 1'b1;
-                    sr_we <= 1'b1;
                     sr_oe <= 1'b1;
-                    byte_drv <= 1'b0;
-
-                    if (do_xfer) begin
-                        // sram should drive bus on read cycle only, this sram
-                        // output is active low, (we_i == 0) is a read cycle!
-                        sr_oe <= we_i;
-
-                        // sram controller drives bus on write cycles only!
-                        byte_drv <= we_i;
-
-                        // doesn't matter if it's a read or write cycle,
-                        // select the sram
-                        sr_cs <= 1'b0;
-                        
-                        word_out <= dat_i;
-                       {word_adr, byte_off} <= {adr_i[16:2], 2'h0};
-                       
-                        state <= st_wait0;
-                    end
-                end
-
-                st_wait0: begin
-                    // only take write signal active if current byte sel bit
-                    // is set
-                    sr_we <= (we_i & byte_sel) ? 1'b0 : 1'b1;
-                    state <= st_wait1;
-                end
+                    state <= st_idle;
 
-                st_wait1: begin
-                    state <= st_wait2;
+                end else if (byte_end) begin
+                    // dio lines are sampled at the end of each byte
+                    {word_adr, byte_off} <= {word_adr, byte_off} + 17'h1;
+                    case (byte_off)
+                        2'h0: rd_dat[7:0]   <= sr_dio;
+                        2'h1: rd_dat[15:8]  <= sr_dio;
+                        2'h2: rd_dat[23:16] <= sr_dio;
+                        2'h3: begin
+                            // full 32-bit data valid with the ack
+                            word_dat <= {sr_dio, rd_dat};
+                            buf_adr  <= word_adr;
+                            buf_ok   <= 1'b1;
+                            ack_o    <= rd_hit;
+
+                            // keep streaming while the words are wanted
+                            if (!rd_hit) begin
+                                sr_cs <= 1'b1;
+                                sr_oe <= 1'b1;
+                                state <= st_idle;
+                            end
+                        end
+                    endcase
                 end
 
-                st_wait2: begin
-                    state <= st_wait3;
-                end
+                // the previous word, still in the buffer
+                if (buf_hit && !(byte_end && (byte_off == 2'h3)))
+                    ack_o <= 1'b1;
+            end
 
-                st_wait3: begin
-                        sr_we <= 1'b1;
-                        state <= st_sample;
-                end
-
-                st_sample: begin
-                    // dio lines are sampled in other code block above. Increment
-                    // the byte offset if more to read or ack if done
-                    state <= last_byte ? st_ack : st_wait0;
-                    byte_off <= byte_off + 1;
+            st_write: begin
+                // only take write signal active in the middle of the byte
+                if (cnt == 4'h0)
+                    sr_we <= 1'b0;
+                if (cnt == BYTE_CLKS - 2)
+                    sr_we <= 1'b1;
 
-                    // Quit driving the bus if the cycle is complete. 
-                    if (last_byte) begin
+                if (byte_end) begin
+                    if (wr_next[2]) begin
+                        // Quit driving the bus, the cycle is complete
                         sr_cs <= 1'b1;
-                        sr_oe <= 1'b1;
                         byte_drv <= 1'b0;
+                        ack_o <= 1'b1;
+                        state <= st_idle;
+                    end else begin
+                        byte_off <= wr_next[1:0];
                     end
                 end
+            end
 
-                st_ack: begin
-                    // full 32-bit data valid in this clock cycle
-                    state <= st_idle;
-                end
-
-                default:
-                    state <= st_idle;
+            default:
+                state <= st_idle;
 
-            endcase
+        endcase
 
+        if (rst) begin
+            state <= st_idle;
+            buf_ok <= 1'b0;
+            sr_cs <= 1'b1;
+            sr_we <= 1'b1;
+            sr_oe <= 1'b1;
+            byte_drv <= 1'b0;
         end
+    end
 
 endmodule
@@ -23,14 +23,25 @@ wire sr_we;
 wire sr_oe;
 wire [16:0] sr_adr;
 
-reg  [7:0] sr_dio_gen;
 wire [7:0] sr_dio_inout;
 
+// BS62LV1027-70 model. Read data shows up 70nS after the address settles,
+// a write lands when the write strobe goes back high.
+reg  [7:0] mem [0:131071];
+wire [7:0] mem_q = mem[sr_adr];
+wire [7:0] sr_dio_gen;
+assign #70 sr_dio_gen = mem_q;
+
 // sram should drive bus when
 // write enable == 1, output enable == 0, chip select == 0
 assign sr_dio_inout =
     (sr_we == 1'b1) && (sr_oe == 1'b0) && (sr_cs == 1'b0) ? sr_dio_gen : 8'hzz;
 
+always @ (posedge sr_we) begin
+    if (sr_cs == 1'b0)
+        mem[sr_adr] <= sr_dio_inout;
+end
+
 wb_sram dut(
     .clk(clk), .rst(rst),
     .we_i(we_i), .cyc_i(cyc_i), .stb_i(stb_i), .ack_o(ack_o),
@@ -39,8 +50,8 @@ wb_sram dut(
     .dat_i(wb_data_write),
     .dat_o(wb_data_read),
     .sel_i(sel_i),
-    
-    // sram stuff.. 
+
+    // sram stuff..
     .sr_cs(sr_cs),
     .sr_we(sr_we),
     .sr_oe(sr_oe),
@@ -55,6 +66,44 @@ initial begin
     forever #10 clk = ~clk; // 20nS clock period
 end
 
+// Clocks from the start of a bus cycle to its ack
+integer clocks;
+integer errors = 0;
+integer n;
+reg [31:0] rd;
+
+task wb_cycle(input we, input [16:0] adr, input [31:0] dat, input [3:0] sel);
+    begin
+        @(posedge clk);
+        we_i <= we;
+        wb_adr <= adr;
+        wb_data_write <= dat;
+        sel_i <= sel;
+        cyc_i <= 1;
+        stb_i <= 1;
+        clocks = 0;
+        @(posedge clk);
+        while (ack_o == 0) begin
+            clocks = clocks + 1;
+            @(posedge clk);
+        end
+        clocks = clocks + 1;
+        rd = wb_data_read;
+        cyc_i <= 0;
+        stb_i <= 0;
+        we_i <= 0;
+    end
+endtask
+
+task check(input [16:0] adr, input [31:0] want);
+    begin
+        if (rd !== want) begin
+            $display("read 0x%05x: 0x%08x, expected 0x%08x", adr, rd, want);
+            errors = errors + 1;
+        end
+    end
+endtask
+
 initial begin
     $dumpfile("wb_sram_tb.vcd");
     $dumpvars;
@@ -64,39 +113,61 @@ initial begin
     stb_i = 1'b0;
     sel_i = 4'h0;
 
-
     wb_adr = 17'hffff;
     wb_data_write = 8'h0;
-    
-    sr_dio_gen = 8'had;
-    #100
 
-    cyc_i = 1;
-    stb_i = 1;
-    wb_adr = 17'h5500;
-    
-    wait (ack_o == 1);
-    #20
-    cyc_i = 0;
-    stb_i = 0;
+    for (n = 0; n < 131072; n = n + 1)
+        mem[n] = n[7:0] ^ n[15:8];
+    #100
 
-    @(posedge clk)
+    // full word write, then read it back
+    wb_cycle(1, 17'h5500, 32'hdeadbeef, 4'hf);
+    $display("write, 4 bytes:     %0d clocks", clocks);
+    wb_cycle(0, 17'h5500, 32'h0, 4'hf);
+    $display("read, single:       %0d clocks", clocks);
+    check(17'h5500, 32'hdeadbeef);
+
+    // byte selects, only the selected bytes change
+    wb_cycle(1, 17'haa00, 32'h11223344, 4'b0100);
+    $display("write, 1 byte:      %0d clocks", clocks);
+    wb_cycle(1, 17'haa00, 32'h55667788, 4'b1001);
+    $display("write, 2 bytes:     %0d clocks", clocks);
+    wb_cycle(0, 17'haa00, 32'h0, 4'hf);
+    check(17'haa00, {8'h55, 8'h22, mem[17'haa01], 8'h88});
+
+    // sequential reads, back to back and with a gap between them as a hart
+    // fetching instructions would have
+    for (n = 0; n < 8; n = n + 1) begin
+        wb_cycle(0, 17'h1000 + n * 4, 32'h0, 4'hf);
+        $display("read, sequential:   %0d clocks", clocks);
+        check(17'h1000 + n * 4, {mem[17'h1003 + n * 4], mem[17'h1002 + n * 4],
+                                 mem[17'h1001 + n * 4], mem[17'h1000 + n * 4]});
+    end
+    for (n = 0; n < 4; n = n + 1) begin
+        wb_cycle(0, 17'h2000 + n * 4, 32'h0, 4'hf);
+        $display("read, seq + 30 clk: %0d clocks", clocks);
+        check(17'h2000 + n * 4, {mem[17'h2003 + n * 4], mem[17'h2002 + n * 4],
+                                 mem[17'h2001 + n * 4], mem[17'h2000 + n * 4]});
+        repeat (30) @(posedge clk);
+    end
+
+    // random reads, the stream never helps
+    for (n = 0; n < 4; n = n + 1) begin
+        wb_cycle(0, 17'h3000 + n * 36, 32'h0, 4'hf);
+        $display("read, random:       %0d clocks", clocks);
+        check(17'h3000 + n * 36, {mem[17'h3003 + n * 36], mem[17'h3002 + n * 36],
+                                  mem[17'h3001 + n * 36], mem[17'h3000 + n * 36]});
+    end
+
+    // a write to the word the stream buffered must not read back stale
+    wb_cycle(0, 17'h4000, 32'h0, 4'hf);
+    repeat (30) @(posedge clk);
+    wb_cycle(1, 17'h4004, 32'hcafef00d, 4'hf);
+    wb_cycle(0, 17'h4004, 32'h0, 4'hf);
+    check(17'h4004, 32'hcafef00d);
 
     #100
-    sel_i <= 4'b1101;
-    wb_data_write <= 32'hdeadbeef;
-    wb_adr <= 17'haa00;
-    cyc_i <= 1;
-    stb_i <= 1;
-    we_i  <= 1;
-
-    wait (ack_o == 1);
-    #20
-    cyc_i = 0;
-    stb_i = 0;
-    we_i = 0;
-    #100
-    
+    $display("%0d errors", errors);
 
     $finish;
 
@@ -0,0 +1,86 @@
+/* SPDX-License-Identifier: [MIT] */
+
+`default_nettype wire
+
+/*
+ * Bus arbiter statistics. Counts completed bus cycles (acks) and wait
+ * cycles, clocks with a cycle pending but the bus granted to another
+ * master, for each bus master. Counters wrap, the host works with
+ * differences between two reads or clears them first.
+ *
+ * Masters in bussel busid order, harts 0 to HARTS-1, then spi, crc, dma and
+ * the telemetry sampler. Hart 0 block RAM cycles use their own RAM port and
+ * don't show up here.
+ *
+ * 0x00 - 0x3C = Bus cycles completed, per master (read only)
+ * 0x40 - 0x7C = Wait cycles, per master (read only)
+ * 0x80 = Clocks since the counters were cleared (read only)
+ * 0x84 = Control
+ *  [0]=clear all counters (write)
+ */
+module wb_arbstat #(
+	parameter MASTERS = 4	/* up to 16 */
+)(
+	input clk,
+	input rst,
+
+	input  [7:0] 	adr_i,
+	input  [31:0] 	dat_i,
+	output [31:0] 	dat_o,
+	input 			we_i,
+	input 			cyc_i,
+	input 			stb_i,
+	output 	reg 	ack_o,
+
+	/* Arbiter state, one bit per master */
+	input  [MASTERS-1:0]	req,	// master cyc
+	input  [MASTERS-1:0]	gnt,	// bussel busid
+	input 			bus_ack
+);
+
+	reg [31:0] grants [0:MASTERS-1];
+	reg [31:0] waits  [0:MASTERS-1];
+	reg [31:0] clocks = 32'h0;
+
+	wire we = cyc_i && stb_i && we_i && !ack_o;
+	wire clear = (we && (adr_i[7:2] == 6'h21) && dat_i[0]) || rst;
+
+	always @ (posedge clk) begin
+		ack_o <= cyc_i && stb_i && !ack_o;
+	end
+
+	reg [31:0] rdt;
+	assign dat_o = rdt;
+	wire [3:0] m_sel = adr_i[5:2];
+	always @(*) begin
+		case (adr_i[7:6])
+			2'h0: rdt = (m_sel < MASTERS) ? grants[m_sel] : 32'h0;
+			2'h1: rdt = (m_sel < MASTERS) ? waits[m_sel] : 32'h0;
+			default: rdt = (adr_i[7:2] == 6'h20) ? clocks : 32'h0;
+		endcase
+	end
+
+	integer m;
+	initial begin
+		for (m = 0; m < MASTERS; m = m + 1) begin
+			grants[m] = 32'h0;
+			waits[m]  = 32'h0;
+		end
+	end
+
+	always @(posedge clk) begin
+		clocks <= clear ? 32'h0 : clocks + 32'h1;
+		for (m = 0; m < MASTERS; m = m + 1) begin
+			if (clear) begin
+				grants[m] <= 32'h0;
+				waits[m]  <= 32'h0;
+			end else begin
+				if (bus_ack && gnt[m])
+					grants[m] <= grants[m] + 32'h1;
+				if (req[m] && !gnt[m])
+					waits[m]  <= waits[m] + 32'h1;
+			end
+		end
+	end
+
+endmodule
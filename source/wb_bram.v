@@ -2,10 +2,20 @@
 
 `default_nettype wire
 
+/*
+ * Dual port block RAM, 4608x32 (18KB) in nine 2KB banks, one XP2 EBR
+ * each. At 32 bits wide an EBR only has a single port, so every bank
+ * serves one port per clock. The two ports only wait for each other when
+ * they start a cycle on the same bank in the same clock. Port A wins, the
+ * port B cycle goes the next clock while port A sees its ack. Port A can't
+ * start another cycle in its ack clock, so port B never starves.
+ *
+ * Bank = adr[14:11]
+ */
 module wb_bram(
 	input clk,
 	input rst,
-	
+
 // This a 4Kx32 RAM + 2KB
 // The lower two address bits are unused but they're
 // declared in the module for clarity.
@@ -13,51 +23,88 @@ module wb_bram(
 // The 15'th address bit is needed to support 2KB more
 // RAM from the 9'th block ram
 //
-	input  [14:0] 	adr_i,
-	input  [31:0] 	dat_i,
-	output [31:0] 	dat_o,
-	input  [3:0]  	sel_i,
-	input 			we_i,
-	input 			cyc_i,
-	input 			stb_i,
-	output 	reg 	ack_o
+	/* Port A */
+	input  [14:0] 	a_adr_i,
+	input  [31:0] 	a_dat_i,
+	output [31:0] 	a_dat_o,
+	input  [3:0]  	a_sel_i,
+	input 			a_we_i,
+	input 			a_cyc_i,
+	input 			a_stb_i,
+	output 	reg 	a_ack_o,
+
+	/* Port B */
+	input  [14:0] 	b_adr_i,
+	input  [31:0] 	b_dat_i,
+	output [31:0] 	b_dat_o,
+	input  [3:0]  	b_sel_i,
+	input 			b_we_i,
+	input 			b_cyc_i,
+	input 			b_stb_i,
+	output 	reg 	b_ack_o
 );
 
-	wire we = we_i && cyc_i && stb_i && !ack_o;
-	
+	localparam BANKS = 9;
+
+	wire [3:0] a_bank = a_adr_i[14:11];
+	wire [3:0] b_bank = b_adr_i[14:11];
+
+	wire a_go = a_cyc_i && a_stb_i && !a_ack_o;
+	wire b_go = b_cyc_i && b_stb_i && !b_ack_o && !(a_go && (a_bank == b_bank));
+
+	reg [3:0] a_bank_q;
+	reg [3:0] b_bank_q;
+
 	always @ (posedge clk) begin
-		ack_o <= cyc_i && stb_i && !ack_o;
+		a_ack_o  <= a_go;
+		b_ack_o  <= b_go;
+		a_bank_q <= a_bank;
+		b_bank_q <= b_bank;
 	end
-	
-	// this single port ram is setup with no-register output
+
+	wire [31:0] q [0:BANKS - 1];
+	assign a_dat_o = (a_bank_q < BANKS) ? q[a_bank_q] : 32'h0;
+	assign b_dat_o = (b_bank_q < BANKS) ? q[b_bank_q] : 32'h0;
+
+	// each single port ram is setup with no-register output
 	// mode. This means the data will be valid 1 clock cycle
 	// after the address has been supplied. This works out
 	// because the ack signal is registered in this module,
 	// which delays the ack output by 1 cycle. Therefore, the
 	// data is valid on the same clock period as ACK=1.
-	pmi_ram_dq_be
-		#(	.pmi_addr_depth(4608),
-			.pmi_addr_width(13),
-			.pmi_data_width(32),
-			.pmi_regmode("noreg"),
-			.pmi_gsr("disable"),
-			.pmi_resetmode("sync"),
-			.pmi_optimization("speed"),
-			.pmi_write_mode("normal"),
-			.pmi_family("common"),
-			.pmi_init_file_format("hex"),
-			// .pmi_init_file("../blinky.hex"),
-			.pmi_byte_size(8),
-			.module_type("pmi_ram_dq_be"))
-	rdq
-	(   .Data(dat_i),
-		.Address(adr_i[14:2]),
-		.Clock(clk),
-		.ClockEn(1'b1), /* Note: could put strobe signal here */
-		.WE(we),
-		.Reset(1'b0),
-		.ByteEn(sel_i),
-		.Q(dat_o)
-	);
+	genvar k;
+	generate
+		for (k = 0; k < BANKS; k = k + 1) begin : bank
+			wire sel_a = a_go && (a_bank == k);
+			wire sel_b = b_go && (b_bank == k);
+
+			pmi_ram_dq_be
+				#(	.pmi_addr_depth(512),
+					.pmi_addr_width(9),
+					.pmi_data_width(32),
+					.pmi_regmode("noreg"),
+					.pmi_gsr("disable"),
+					.pmi_resetmode("sync"),
+					.pmi_optimization("speed"),
+					.pmi_write_mode("normal"),
+					.pmi_family("common"),
+					.pmi_init_file_format("hex"),
+					.pmi_byte_size(8),
+`ifdef VERILATOR
+					.sim_base(k * 512), /* model only, see pmi_ram_dq_be.v */
+`endif
+					.module_type("pmi_ram_dq_be"))
+			rdq
+			(   .Data(sel_a ? a_dat_i : b_dat_i),
+				.Address(sel_a ? a_adr_i[10:2] : b_adr_i[10:2]),
+				.Clock(clk),
+				.ClockEn(1'b1),
+				.WE((sel_a && a_we_i) || (sel_b && b_we_i)),
+				.Reset(1'b0),
+				.ByteEn(sel_a ? a_sel_i : b_sel_i),
+				.Q(q[k])
+			);
+		end
+	endgenerate
 
 endmodule
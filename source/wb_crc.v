@@ -0,0 +1,129 @@
+/* SPDX-License-Identifier: [MIT] */
+
+`default_nettype wire
+
+/*
+ * CRC32 engine. Walks a region of memory as a wishbone bus master and
+ * computes the IEEE 802.3 CRC32 (same as zlib crc32) of the bytes in
+ * address order. The host uses this to verify a loaded image by reading
+ * a single word instead of reading back the whole image.
+ *
+ * 0x00 = Start address, word aligned (read write)
+ * 0x04 = Length in words (read write)
+ * 0x08 = Control / status
+ *  [0]=start (write), [0]=busy (read)
+ * 0x0C = CRC result (read only)
+ *
+ * The CRC is computed one bit per clock, each word takes a bus cycle plus
+ * 32 clocks. The bus is only requested for the read, other masters are
+ * free to use it while the word gets shifted through the CRC.
+ */
+module wb_crc(
+	input clk,
+	input rst,
+
+	// wishbone slave, register interface
+	input  [3:0] 	adr_i,
+	input  [31:0] 	dat_i,
+	output [31:0] 	dat_o,
+	input 			we_i,
+	input 			cyc_i,
+	input 			stb_i,
+	output 	reg 	ack_o,
+
+	// wishbone master, memory read only
+	output [23:0] 	m_adr_o,
+	input  [31:0] 	m_dat_i,
+	output 			m_cyc_o,
+	output 			m_stb_o,
+	input 			m_ack_i
+);
+
+	parameter [2:0] state_idle	= 3'b001;
+	parameter [2:0] state_read	= 3'b010;
+	parameter [2:0] state_shift	= 3'b100;
+
+	reg [2:0]  state = state_idle;
+	reg [23:0] addr;	// start address register
+	reg [23:0] len;		// length register, words
+	reg [23:0] ptr;		// current address
+	reg [23:0] remain;	// words remaining
+	reg [31:0] word;	// word being shifted through the CRC
+	reg [4:0]  bitcnt;
+	reg [31:0] crc;
+	wire       busy = (state != state_idle);
+
+	/*
+	 * Register writes are qualified with !ack_o so the start strobe is a
+	 * single clock pulse.
+	 */
+	wire we = cyc_i && stb_i && we_i && !ack_o;
+	wire we_addr  = we && (adr_i[3:2] == 2'h0);
+	wire we_len   = we && (adr_i[3:2] == 2'h1);
+	wire we_start = we && (adr_i[3:2] == 2'h2) && dat_i[0];
+
+	always @ (posedge clk) begin
+		ack_o <= cyc_i && stb_i && !ack_o;
+	end
+
+	reg [31:0] rdt;
+	assign dat_o = rdt;
+	always @(*) begin
+		case (adr_i[3:2])
+			2'h0: rdt = {8'h0, addr};
+			2'h1: rdt = {8'h0, len};
+			2'h2: rdt = {31'h0, busy};
+			2'h3: rdt = ~crc;
+		endcase
+	end
+
+	assign m_adr_o = ptr;
+	assign m_cyc_o = (state == state_read);
+	assign m_stb_o = (state == state_read);
+
+	always @(posedge clk) begin
+		if (we_addr)
+			addr <= {dat_i[23:2], 2'b00};
+		if (we_len)
+			len <= dat_i[23:0];
+
+		case (state)
+			state_idle: begin
+					if (we_start) begin
+						ptr    <= addr;
+						remain <= len;
+						crc    <= 32'hFFFFFFFF;
+						state  <= (len == 0) ? state_idle : state_read;
+					end
+				end
+
+			state_read: begin
+					/* Wait for the bus, then latch the word */
+					if (m_ack_i) begin
+						word   <= m_dat_i;
+						bitcnt <= 5'h0;
+						ptr    <= ptr + 24'h4;
+						remain <= remain - 24'h1;
+						state  <= state_shift;
+					end
+				end
+
+			state_shift: begin
+					/* Reflected CRC, least significant bit of byte 0 first */
+					crc    <= {1'b0, crc[31:1]} ^
+								((crc[0] ^ word[0]) ? 32'hEDB88320 : 32'h0);
+					word   <= {1'b0, word[31:1]};
+					bitcnt <= bitcnt + 5'h1;
+					if (&bitcnt)
+						state <= (remain == 0) ? state_idle : state_read;
+				end
+
+			default:
+				state <= state_idle;
+		endcase
+
+		if (rst)
+			state <= state_idle;
+	end
+
+endmodule
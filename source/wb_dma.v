@@ -0,0 +1,213 @@
+/* SPDX-License-Identifier: [MIT] */
+
+`default_nettype wire
+
+/*
+ * DMA engine, a wishbone bus master that moves words without a hart.
+ *
+ * Modes:
+ *  copy, 'len' words from 'src' to 'dst'
+ *  fill, 'len' words of the fill value to 'dst'
+ *  list, 'len' descriptors at 'src', two words each:
+ *   word 0: [31:24]=wait in mS before the write, [23:2]=address
+ *   word 1: data
+ *   For writing gio registers from a table, timed actuator sequences.
+ * Addresses are word aligned, every write is a full word. A fixed address
+ * doesn't increment, for feeding a register or reading one.
+ *
+ * 0x00 = Source address / descriptor list (read write)
+ * 0x04 = Destination address (read write)
+ * 0x08 = Length in words, or descriptors (read write)
+ * 0x0C = Control / status
+ *  [9]=dst fixed, [8]=src fixed, [5:4]=mode, 0 copy, 1 fill, 2 list
+ *  [1]=stop (write), [0]=start (write), [0]=busy (read)
+ *  Mode and flags can't change while busy.
+ * 0x10 = Fill value (read write)
+ * 0x14 = Words or descriptors left (read only)
+ *
+ * cyc drops for a clock after every bus cycle, bussel only rearbitrates
+ * between cycles, so the harts get their turns in between.
+ */
+module wb_dma #(
+	parameter CLK_KHZ = 50000
+)(
+	input clk,
+	input rst,
+
+	// wishbone slave, register interface
+	input  [4:0] 	adr_i,
+	input  [31:0] 	dat_i,
+	output [31:0] 	dat_o,
+	input 			we_i,
+	input 			cyc_i,
+	input 			stb_i,
+	output 	reg 	ack_o,
+
+	// wishbone master
+	output [23:0] 	m_adr_o,
+	output [31:0] 	m_dat_o,
+	input  [31:0] 	m_dat_i,
+	output 			m_we_o,
+	output 			m_cyc_o,
+	output 			m_stb_o,
+	input 			m_ack_i
+);
+
+	parameter [4:0] state_idle	= 5'b00001;
+	parameter [4:0] state_read	= 5'b00010;	// source word, or descriptor word 0
+	parameter [4:0] state_data	= 5'b00100;	// descriptor word 1
+	parameter [4:0] state_wait	= 5'b01000;
+	parameter [4:0] state_write	= 5'b10000;
+
+	localparam [1:0] MODE_COPY = 2'h0;
+	localparam [1:0] MODE_FILL = 2'h1;
+	localparam [1:0] MODE_LIST = 2'h2;
+
+	reg [4:0]  state = state_idle;
+	reg [23:0] src;		// source address register
+	reg [23:0] dst;		// destination address register
+	reg [23:0] len;		// length register
+	reg [31:0] fill;	// fill value
+	reg [1:0]  mode;
+	reg        src_fix;
+	reg        dst_fix;
+
+	reg [23:0] rptr;	// current read address
+	reg [23:0] wptr;	// current write address
+	reg [23:0] remain;
+	reg [31:0] word;	// word on its way to wptr
+	reg [7:0]  wait_ms;
+	reg [15:0] ms_div;
+	reg        halt = 1'b0;
+	reg        gap = 1'b0;
+	wire       busy = (state != state_idle);
+
+	/*
+	 * Register writes are qualified with !ack_o so the start strobe is a
+	 * single clock pulse.
+	 */
+	wire we = cyc_i && stb_i && we_i && !ack_o;
+	wire we_src   = we && (adr_i[4:2] == 3'h0);
+	wire we_dst   = we && (adr_i[4:2] == 3'h1);
+	wire we_len   = we && (adr_i[4:2] == 3'h2);
+	wire we_ctl   = we && (adr_i[4:2] == 3'h3);
+	wire we_fill  = we && (adr_i[4:2] == 3'h4);
+	wire we_start = we_ctl && dat_i[0] && !busy;
+	wire we_stop  = we_ctl && dat_i[1];
+
+	always @ (posedge clk) begin
+		ack_o <= cyc_i && stb_i && !ack_o;
+	end
+
+	reg [31:0] rdt;
+	assign dat_o = rdt;
+	always @(*) begin
+		case (adr_i[4:2])
+			3'h0: rdt = {8'h0, src};
+			3'h1: rdt = {8'h0, dst};
+			3'h2: rdt = {8'h0, len};
+			3'h3: rdt = {22'h0, dst_fix, src_fix, 2'h0, mode, 3'h0, busy};
+			3'h4: rdt = fill;
+			3'h5: rdt = {8'h0, remain};
+			default: rdt = 32'h0;
+		endcase
+	end
+
+	wire reading = (state == state_read) || (state == state_data);
+	assign m_adr_o = reading ? rptr : wptr;
+	assign m_dat_o = (mode == MODE_FILL) ? fill : word;
+	assign m_we_o  = (state == state_write);
+	assign m_cyc_o = (reading || (state == state_write)) && !gap;
+	assign m_stb_o = m_cyc_o;
+
+	/* Where to go once a word is written */
+	wire last = (remain == 24'h1);
+	wire [4:0] state_next = last ? state_idle :
+							(mode == MODE_FILL) ? state_write : state_read;
+
+	always @(posedge clk) begin
+		if (we_src)
+			src <= {dat_i[23:2], 2'b00};
+		if (we_dst)
+			dst <= {dat_i[23:2], 2'b00};
+		if (we_len)
+			len <= dat_i[23:0];
+		if (we_fill)
+			fill <= dat_i;
+		if (we_ctl && !busy) begin
+			mode    <= dat_i[5:4];
+			src_fix <= dat_i[8];
+			dst_fix <= dat_i[9];
+		end
+
+		gap <= m_ack_i;
+
+		case (state)
+			state_idle: begin
+					if (we_start) begin
+						rptr   <= src;
+						wptr   <= dst;
+						remain <= len;
+						state  <= (len == 0 || dat_i[5:4] == 2'h3) ? state_idle :
+								(dat_i[5:4] == MODE_FILL) ? state_write : state_read;
+					end
+				end
+
+			state_read: begin
+					/* Source word, or the descriptor address and wait */
+					if (m_ack_i) begin
+						if (mode == MODE_LIST) begin
+							wptr    <= {m_dat_i[23:2], 2'b00};
+							wait_ms <= m_dat_i[31:24];
+							rptr    <= rptr + 24'h4;
+							state   <= state_data;
+						end else begin
+							word    <= m_dat_i;
+							if (!src_fix)
+								rptr <= rptr + 24'h4;
+							state   <= state_write;
+						end
+					end
+				end
+
+			state_data: begin
+					if (m_ack_i) begin
+						word   <= m_dat_i;
+						rptr   <= rptr + 24'h4;
+						ms_div <= 16'h0;
+						state  <= state_wait;
+					end
+				end
+
+			state_wait: begin
+					ms_div <= (ms_div == CLK_KHZ - 1) ? 16'h0 : ms_div + 16'h1;
+					if (wait_ms == 8'h0)
+						state <= state_write;
+					else if (ms_div == CLK_KHZ - 1)
+						wait_ms <= wait_ms - 8'h1;
+				end
+
+			state_write: begin
+					if (m_ack_i) begin
+						if (!dst_fix && (mode != MODE_LIST))
+							wptr <= wptr + 24'h4;
+						remain <= remain - 24'h1;
+						state  <= state_next;
+					end
+				end
+
+			default:
+				state <= state_idle;
+		endcase
+
+		/* A stop takes effect once the bus cycle under way is done */
+		if (we_stop && busy)
+			halt <= 1'b1;
+		else if (!busy)
+			halt <= 1'b0;
+
+		if (rst || (halt && (m_ack_i || (state == state_wait))))
+			state <= state_idle;
+	end
+
+endmodule
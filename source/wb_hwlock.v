@@ -0,0 +1,77 @@
+/* SPDX-License-Identifier: [MIT] */
+
+`default_nettype wire
+
+/*
+ * Hardware lock registers. Each lock is a test-and-set register, a read
+ * takes the lock if it's free. Locks live outside of memory, so spinning
+ * on one doesn't touch the RAM the other bus masters need. Holding a hart
+ * in reset releases every lock it owns, so a lock taken before a reload
+ * isn't left stuck.
+ *
+ * 0x00 - 0x7C = Lock 0 - 31
+ *  read:  0 if the lock was free and is now held by the reader,
+ *         otherwise the bussel busid of the current holder, one-hot
+ *  write: release the lock, any value
+ * 0x80 = Held locks, one bit per lock (read only)
+ */
+module wb_hwlock #(
+	parameter LOCKS = 32,
+	parameter HARTS = 2,		/* busid bits 0 .. HARTS-1 */
+	parameter MASTERS = HARTS + 2
+)(
+	input clk,
+	input rst,
+
+	input  [7:0] 	adr_i,
+	input  [31:0] 	dat_i,
+	output [31:0] 	dat_o,
+	input 			we_i,
+	input 			cyc_i,
+	input 			stb_i,
+	output 	reg 	ack_o,
+
+	/* Bus master ID, recorded as the lock owner */
+	input  [MASTERS-1:0]	busid,
+	/* Harts held in reset */
+	input  [HARTS-1:0]	hart_rst
+);
+
+	reg [LOCKS-1:0] held = 0;
+	reg [MASTERS-1:0] owner [0:LOCKS-1];
+	reg [31:0]      rdt;
+	integer n;
+
+	/* Every access is acted on once, in the clock before the ack */
+	wire acc = cyc_i && stb_i && !ack_o;
+	wire [4:0] k = adr_i[6:2];
+	wire lock_sel = !adr_i[7] && (k < LOCKS);
+
+	assign dat_o = rdt;
+
+	always @ (posedge clk) begin
+		ack_o <= acc;
+
+		if (acc) begin
+			if (!lock_sel) begin
+				rdt <= held;
+			end else if (we_i) begin
+				held[k] <= 1'b0;
+			end else if (!held[k]) begin
+				held[k]  <= 1'b1;
+				owner[k] <= busid;
+				rdt      <= 32'h0;
+			end else begin
+				rdt      <= owner[k];
+			end
+		end
+
+		for (n = 0; n < LOCKS; n = n + 1)
+			if (|(owner[n][HARTS-1:0] & hart_rst))
+				held[n] <= 1'b0;
+
+		if (rst)
+			held <= 0;
+	end
+
+endmodule
@@ -0,0 +1,133 @@
+/* SPDX-License-Identifier: [MIT] */
+
+`default_nettype wire
+
+/*
+ * Inter-hart mailboxes, a FIFO in each direction. Each hart has its own
+ * port, not on the shared bus, so a hart waiting on its mailbox doesn't
+ * hold up anybody else.
+ *
+ * Per port:
+ * 0x0 = Data
+ *  write: send a message to the other hart, waits while its FIFO is full
+ *  read:  receive a message, waits until one arrives
+ * 0x4 = Status (read only)
+ *  [15:8]=free slots in the outbound FIFO, [7:0]=messages waiting
+ *
+ * A data access that has to wait holds off the ack, the hart stalls on the
+ * bus until the other side catches up.
+ *
+ * rst empties both FIFOs. It's held while either hart is in reset, so a
+ * reloaded hart doesn't start on stale messages, and a hart that sends to
+ * one held in reset doesn't stall.
+ */
+module wb_mailbox #(
+	parameter DEPTH_LOG2 = 2
+)(
+	input clk,
+	input rst,
+
+	/* Port A, hart 0 */
+	input  [3:0] 	a_adr_i,
+	input  [31:0] 	a_dat_i,
+	output reg [31:0] a_dat_o,
+	input 			a_we_i,
+	input 			a_cyc_i,
+	input 			a_stb_i,
+	output 	reg 	a_ack_o,
+
+	/* Port B, hart 1 */
+	input  [3:0] 	b_adr_i,
+	input  [31:0] 	b_dat_i,
+	output reg [31:0] b_dat_o,
+	input 			b_we_i,
+	input 			b_cyc_i,
+	input 			b_stb_i,
+	output 	reg 	b_ack_o
+);
+
+	wire [31:0]         ab_dout, ba_dout;
+	wire [DEPTH_LOG2:0] ab_count, ba_count;
+	wire                ab_full, ab_empty, ba_full, ba_empty;
+
+	localparam [DEPTH_LOG2:0] DEPTH = 1 << DEPTH_LOG2;
+
+	wire a_data = (a_adr_i[3:2] == 2'h0);
+	wire b_data = (b_adr_i[3:2] == 2'h0);
+
+	/* Data accesses go once there's a message, or room for one */
+	wire a_go = a_cyc_i && a_stb_i && !a_ack_o &&
+				(!a_data || (a_we_i ? !ab_full : !ba_empty));
+	wire b_go = b_cyc_i && b_stb_i && !b_ack_o &&
+				(!b_data || (b_we_i ? !ba_full : !ab_empty));
+
+	mbx_fifo #(.DEPTH_LOG2(DEPTH_LOG2)) ab (
+		.clk(clk), .rst(rst),
+		.push(a_go && a_data && a_we_i), .din(a_dat_i),
+		.pop(b_go && b_data && !b_we_i), .dout(ab_dout),
+		.count(ab_count), .full(ab_full), .empty(ab_empty)
+	);
+
+	mbx_fifo #(.DEPTH_LOG2(DEPTH_LOG2)) ba (
+		.clk(clk), .rst(rst),
+		.push(b_go && b_data && b_we_i), .din(b_dat_i),
+		.pop(a_go && a_data && !a_we_i), .dout(ba_dout),
+		.count(ba_count), .full(ba_full), .empty(ba_empty)
+	);
+
+	/* Status fields, free outbound slots and messages waiting */
+	wire [7:0] a_free = DEPTH - ab_count;
+	wire [7:0] a_wait = ba_count;
+	wire [7:0] b_free = DEPTH - ba_count;
+	wire [7:0] b_wait = ab_count;
+
+	always @ (posedge clk) begin
+		a_ack_o <= a_go;
+		b_ack_o <= b_go;
+		a_dat_o <= a_data ? ba_dout : {16'h0, a_free, a_wait};
+		b_dat_o <= b_data ? ab_dout : {16'h0, b_free, b_wait};
+	end
+
+endmodule
+
+
+/* Small synchronous FIFO, dout is the oldest entry */
+module mbx_fifo #(
+	parameter DEPTH_LOG2 = 2
+)(
+	input clk,
+	input rst,
+
+	input 			push,
+	input  [31:0] 	din,
+	input 			pop,
+	output [31:0] 	dout,
+
+	output [DEPTH_LOG2:0] count,
+	output 			full,
+	output 			empty
+);
+
+	reg [31:0]         mem [0:(1 << DEPTH_LOG2) - 1];
+	reg [DEPTH_LOG2:0] wp = 0;
+	reg [DEPTH_LOG2:0] rp = 0;
+
+	assign count = wp - rp;
+	assign full  = (count == (1 << DEPTH_LOG2));
+	assign empty = (wp == rp);
+	assign dout  = mem[rp[DEPTH_LOG2 - 1:0]];
+
+	always @(posedge clk) begin
+		if (push) begin
+			mem[wp[DEPTH_LOG2 - 1:0]] <= din;
+			wp <= wp + 1'b1;
+		end
+		if (pop)
+			rp <= rp + 1'b1;
+		if (rst) begin
+			wp <= 0;
+			rp <= 0;
+		end
+	end
+
+endmodule
@@ -0,0 +1,108 @@
+/* SPDX-License-Identifier: [MIT] */
+
+`default_nettype wire
+
+/*
+ * Performance counters for the harts and the SPI slave bus master.
+ * Counters run all the time. Reads return the value at the last snapshot,
+ * so a set of counters read one at a time is consistent. Counters wrap,
+ * use differences between snapshots or clear them first.
+ *
+ * 0x00 = Control
+ *  [0]=snapshot (write), [1]=clear counters (write)
+ *  A write with both bits set snapshots the values before the clear.
+ * 0x04 = Number of harts (read only)
+ * 0x10 = SPI slave bus cycles completed
+ * 0x14 = SPI slave clocks waiting for a bus grant
+ *
+ * Per hart N, at 0x20 + 0x20 * N:
+ * 0x00 = Clocks out of reset
+ * 0x04 = Instructions retired, SERV fetches each instruction once
+ * 0x08 = Clocks with an instruction fetch in progress
+ * 0x0C = Clocks with a load or store in progress
+ * 0x10 = Clocks waiting for a bus grant from bussel
+ */
+module wb_perf #(
+	parameter HARTS = 2		/* up to 15 */
+)(
+	input clk,
+	input rst,
+
+	input  [8:0] 	adr_i,
+	input  [31:0] 	dat_i,
+	output [31:0] 	dat_o,
+	input 			we_i,
+	input 			cyc_i,
+	input 			stb_i,
+	output 	reg 	ack_o,
+
+	/* Events, one bit per hart */
+	input  [HARTS-1:0]	hart_run,
+	input  [HARTS-1:0]	ibus_cyc,
+	input  [HARTS-1:0]	ibus_ack,
+	input  [HARTS-1:0]	dbus_cyc,
+	input  [HARTS-1:0]	bus_wait,
+
+	input 			spi_ack,
+	input 			spi_wait
+);
+
+	localparam N = 2 + 5 * HARTS;
+
+	reg  [31:0] cnt  [0:N - 1];
+	reg  [31:0] snap [0:N - 1];
+	wire [N - 1:0] ev;
+
+	assign ev[0] = spi_ack;
+	assign ev[1] = spi_wait;
+
+	genvar h;
+	generate
+		for (h = 0; h < HARTS; h = h + 1) begin : hart
+			assign ev[2 + 5 * h] = hart_run[h];
+			assign ev[3 + 5 * h] = ibus_ack[h];
+			assign ev[4 + 5 * h] = ibus_cyc[h];
+			assign ev[5 + 5 * h] = dbus_cyc[h];
+			assign ev[6 + 5 * h] = bus_wait[h];
+		end
+	endgenerate
+
+	wire we = cyc_i && stb_i && we_i && !ack_o;
+	wire we_ctl = we && (adr_i[8:2] == 7'h0);
+	wire snapshot = we_ctl && dat_i[0];
+	wire clear = (we_ctl && dat_i[1]) || rst;
+
+	always @ (posedge clk) begin
+		ack_o <= cyc_i && stb_i && !ack_o;
+	end
+
+	/* Register address to counter index, N for unused addresses */
+	wire [3:0] slot = adr_i[8:5] - 4'h1;
+	wire [7:0] idx  = (adr_i[8:5] == 4'h0) ?
+						((adr_i[4:3] == 2'h2) ? {7'h0, adr_i[2]} : N) :
+					  ((slot < HARTS) && (adr_i[4:2] < 3'h5)) ?
+						2 + 5 * slot + adr_i[4:2] : N;
+
+	assign dat_o = (idx < N) ? snap[idx] :
+					(adr_i[8:2] == 7'h1) ? HARTS : 32'h0;
+
+	integer n;
+	initial begin
+		for (n = 0; n < N; n = n + 1) begin
+			cnt[n]  = 32'h0;
+			snap[n] = 32'h0;
+		end
+	end
+
+	always @(posedge clk) begin
+		for (n = 0; n < N; n = n + 1) begin
+			if (snapshot)
+				snap[n] <= cnt[n];
+			if (clear)
+				cnt[n] <= 32'h0;
+			else if (ev[n])
+				cnt[n] <= cnt[n] + 32'h1;
+		end
+	end
+
+endmodule
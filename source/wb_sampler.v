@@ -0,0 +1,128 @@
+/* SPDX-License-Identifier: [MIT] */
+
+`default_nettype wire
+
+/*
+ * Telemetry sampler. At a programmable period it snapshots the gio status
+ * registers (rdt0 - rdt6) and writes them into a ring buffer in memory as
+ * a bus master, the host drains the ring over SPI. No CPU cycles are used
+ * for sampling.
+ *
+ * Each sample is 8 words, gio rdt0 - rdt6 followed by the sample number.
+ * Sample n is stored at base + 32 * (n % depth). The default base is the
+ * top of the SRAM, kept out of the firmware's way in sw/machine.ld.
+ *
+ * 0x00 = Control
+ *  [0]=enable (read write), [1]=clear sample count (write)
+ * 0x04 = Sample period in clocks, 8 minimum (read write)
+ * 0x08 = Sample count, samples below this are complete (read only)
+ * 0x0C = Ring depth in samples (read only)
+ * 0x10 = Ring base address (read write)
+ *
+ * A tick while the previous sample is still being written is dropped. cyc
+ * drops for a clock after every word, bussel only rearbitrates between
+ * cycles, so the harts get their turns in between.
+ */
+module wb_sampler #(
+	parameter DEPTH_LOG2 = 8,
+	parameter [23:0] BASE = 24'h81E000
+)(
+	input clk,
+	input rst,
+
+	input  [4:0] 	adr_i,
+	input  [31:0] 	dat_i,
+	output [31:0] 	dat_o,
+	input 			we_i,
+	input 			cyc_i,
+	input 			stb_i,
+	output 	reg 	ack_o,
+
+	// wishbone master, ring writes
+	output [23:0] 	m_adr_o,
+	output [31:0] 	m_dat_o,
+	output 			m_we_o,
+	output 			m_cyc_o,
+	output 			m_stb_o,
+	input 			m_ack_i,
+
+	/* gio rdt6 - rdt0 */
+	input  [223:0]	tlm
+);
+
+	reg         enable = 1'b0;
+	reg [31:0]  period = 32'd50000; // 1kHz
+	reg [31:0]  divcnt;
+	reg [31:0]  count = 32'h0;	// samples written
+	reg [23:0]  base = BASE;
+	reg [223:0] snap;	// sample being written, shifted out a word at a time
+	reg [2:0]   wptr;	// word within the sample
+	reg         busy = 1'b0;
+	reg         gap = 1'b0;
+
+	wire we = cyc_i && stb_i && we_i && !ack_o;
+	wire we_ctl    = we && (adr_i[4:2] == 3'h0);
+	wire we_period = we && (adr_i[4:2] == 3'h1);
+	wire we_base   = we && (adr_i[4:2] == 3'h4);
+
+	wire tick = enable && (divcnt == period - 32'h1);
+
+	always @ (posedge clk) begin
+		ack_o <= cyc_i && stb_i && !ack_o;
+	end
+
+	reg [31:0] rdt;
+	assign dat_o = rdt;
+	always @(*) begin
+		case (adr_i[4:2])
+			3'h0: rdt = {31'h0, enable};
+			3'h1: rdt = period;
+			3'h2: rdt = count;
+			3'h3: rdt = 32'h1 << DEPTH_LOG2;
+			3'h4: rdt = {8'h0, base};
+			default: rdt = 32'h0;
+		endcase
+	end
+
+	assign m_adr_o = base + {count[DEPTH_LOG2 - 1:0], wptr, 2'b00};
+	assign m_dat_o = (wptr == 3'h7) ? count : snap[31:0];
+	assign m_we_o  = 1'b1;
+	assign m_cyc_o = busy && !gap;
+	assign m_stb_o = m_cyc_o;
+
+	always @(posedge clk) begin
+		if (we_ctl)
+			enable <= dat_i[0];
+		if (we_period)
+			period <= (dat_i < 32'h8) ? 32'h8 : dat_i;
+		if (we_base)
+			base <= {dat_i[23:2], 2'b00};
+
+		divcnt <= (tick || !enable) ? 32'h0 : divcnt + 32'h1;
+		gap <= m_ack_i;
+
+		if (busy) begin
+			if (m_ack_i) begin
+				snap <= {32'h0, snap[223:32]};
+				wptr <= wptr + 3'h1;
+				if (wptr == 3'h7) begin
+					busy  <= 1'b0;
+					count <= count + 32'h1;
+				end
+			end
+		end else if (tick) begin
+			snap <= tlm;
+			wptr <= 3'h0;
+			busy <= 1'b1;
+		end
+
+		if (we_ctl && dat_i[1])
+			count <= 32'h0;
+
+		if (rst) begin
+			enable <= 1'b0;
+			busy   <= 1'b0;
+		end
+	end
+
+endmodule
@@ -5,6 +5,7 @@ module wb_servant
 (
  input	wire			wb_clk,
  input	wire 			wb_rst,
+ input	wire 			timer_irq,
  output	wire	[31:0]	wb_cpu_adr,
  output	wire	[31:0]	wb_cpu_dat,
  output	wire	[3:0] 	wb_cpu_sel,
@@ -12,13 +13,18 @@ module wb_servant
  output	wire			wb_cpu_cyc,
  output	wire			wb_cpu_stb,
  input	wire	[31:0] 	wb_cpu_rdt,
- input	wire			wb_cpu_ack
+ input	wire			wb_cpu_ack,
+
+ /* Performance counter events */
+ output	wire			ev_ibus_cyc,
+ output	wire			ev_ibus_ack,
+ output	wire			ev_dbus_cyc
 );
 
    parameter memsize = 16384;
    parameter reset_strategy = "MINI";
    parameter sim = 0;
-   parameter with_csr = 0;
+   parameter with_csr = 1;
    parameter with_mdu = 1;
  
    assign wb_cpu_stb = wb_cpu_cyc;
@@ -36,6 +42,10 @@ module wb_servant
    wire	[31:0]	wb_dbus_rdt;
    wire			wb_dbus_ack;
 
+   assign ev_ibus_cyc = wb_ibus_cyc;
+   assign ev_ibus_ack = wb_ibus_ack;
+   assign ev_dbus_cyc = wb_dbus_cyc;
+
    wire	[31:0]	wb_dmem_adr;
    wire	[31:0]	wb_dmem_dat;
    wire	[3:0]	wb_dmem_sel;
@@ -86,7 +96,7 @@ module wb_servant
      (
       .clk      (wb_clk),
       .i_rst    (wb_rst),
-      .i_timer_irq  (1'b0),
+      .i_timer_irq  (timer_irq),
 
       .o_ibus_adr   (wb_ibus_adr),
       .o_ibus_cyc   (wb_ibus_cyc),
@@ -2,6 +2,28 @@
 
 `default_nettype wire
 
+/*
+ * SPI slave to wishbone master bridge. Each chip select window carries a
+ * command word followed by data words, the address auto increments.
+ *
+ * Command word
+ *  [31:28] opcode, 0=write, 1=read, 2=read with turnaround
+ *  [27:24] byte enables (write), dummy byte count (opcode 2)
+ *  [23:0]  address
+ *
+ * A plain read (opcode 1) has half a SPI clock between the end of the
+ * command and the first data bit to complete the bus read. That limits
+ * the SPI clock to a few MHz. Opcode 2 has the host clock out [27:24]
+ * dummy bytes before the data, the first word is fetched during the
+ * dummy bytes.
+ *
+ * Burst reads from memory (BRAM, SRAM) prefetch the next word while the
+ * current one is shifted out, so only the first word of a burst has to
+ * meet the turnaround. Register regions have read side effects on some
+ * peripherals, a read there fetches exactly the addressed word and then
+ * stops. Any further words of the command read as 0xDEADDEAD, reading
+ * several registers takes one command per word.
+ */
 module wb_spis_master(
 	input clk,
 	
@@ -22,16 +44,21 @@ module wb_spis_master(
 	input 			ack_i
 );
 
-	parameter [5:0] state_idle			= 6'b000000;
-	parameter [5:0] state_rcmd			= 6'b000001;
-	parameter [5:0] state_rdata_cyc		= 6'b000010;
-	parameter [5:0] state_wdata_cyc 	= 6'b000100;
-	parameter [5:0] state_wdata_wait	= 6'b001000;
-	parameter [5:0] state_rdata_wait	= 6'b010000;
+	parameter [7:0] state_idle			= 8'b00000000;
+	parameter [7:0] state_rcmd			= 8'b00000001;
+	parameter [7:0] state_rdata_cyc		= 8'b00000010;
+	parameter [7:0] state_wdata_cyc 	= 8'b00000100;
+	parameter [7:0] state_wdata_wait	= 8'b00001000;
+	parameter [7:0] state_rdone			= 8'b00010000;
+	parameter [7:0] state_rpf_cyc		= 8'b00100000;
+	parameter [7:0] state_rpf_wait		= 8'b01000000;
 
-	reg [5:0] state;
+	reg [7:0] state;
 	reg [3:0] byte_en;
 	reg [23:0] addr;
+	reg [31:0] pf_data;	/* prefetched read data */
+	reg [1:0]  pf_skip;	/* boundaries left before the prefetched word goes out */
+	reg        pf_late;	/* a word boundary passed while the prefetch was pending */
 
 	/* SPI slave signals */
 	wire [31:0]	spi_data;
@@ -40,7 +67,22 @@ module wb_spis_master(
 	wire 		boundary;
 	wire 		op_read  = (spi_data[31:28] == 4'h1);
 	wire 		op_write = (spi_data[31:28] == 4'h0);
-	wire		spi_load = (state == state_rdata_cyc) && (ack_i);
+	wire 		op_fread = (spi_data[31:28] == 4'h2);
+	wire [3:0]	dummy    = spi_data[27:24];
+
+	/*
+	 * Opcode 2 moves the first read boundary to the end of the dummy bytes,
+	 * after that boundaries fall on every 32 bits of data again.
+	 */
+	wire [2:0]	dummy_pre   = 3'd4 - {1'b0, dummy[1:0]};
+	wire		spi_preset  = (state == state_rcmd) && op_fread && (dummy[1:0] != 2'b00);
+
+	/* Only memory regions (adr[22] == 0) are safe to read ahead */
+	wire		pf_ok       = (addr[22] == 1'b0);
+
+	wire		spi_load_rd = (state == state_rdata_cyc) && (ack_i);
+	wire		spi_load_pf = (state == state_rpf_wait) && boundary && (pf_skip == 2'h0);
+	wire		spi_load    = spi_load_rd || spi_load_pf;
 
 	spis spi(
 		.clk(clk),
@@ -50,8 +92,10 @@ module wb_spis_master(
 		.spi_mosi(spi_mosi),
 		.spi_miso(spi_miso),
 		
+		.i_preset(spi_preset),
+		.i_preset_cnt({dummy_pre, 3'b000}),
 		.i_load(spi_load),
-		.i_data(dat_i),
+		.i_data(spi_load_pf ? pf_data : dat_i),
 		.o_data(spi_data),
 		
 		.boundary(boundary),
@@ -62,14 +106,14 @@ module wb_spis_master(
 	
 
 	/* Wishbone controller state machine signals */
-	assign sel_o = byte_en;
+	assign sel_o = we_o ? byte_en : 4'hf;
 	assign adr_o = addr;
 	assign dat_o = spi_data;
 	assign we_o	= (state == state_wdata_cyc);
 	
 	/* cycle and strobe lines are always the same in this simple implementation */
-	assign cyc_o = (state == state_wdata_cyc) || (state == state_rdata_cyc);
-	assign stb_o = (state == state_wdata_cyc) || (state == state_rdata_cyc);
+	assign cyc_o = (state == state_wdata_cyc) || (state == state_rdata_cyc) || (state == state_rpf_cyc);
+	assign stb_o = (state == state_wdata_cyc) || (state == state_rdata_cyc) || (state == state_rpf_cyc);
 	
 	always @(posedge clk) begin
 		
@@ -90,8 +134,10 @@ module wb_spis_master(
 				state_rcmd: begin // Wait until command arrives, then decode
 							if (boundary) begin
 							
-								if (op_read)
+								if (op_read || (op_fread && dummy == 4'h0))
 									state <= state_rdata_cyc;
+								else if (op_fread)
+									state <= state_rpf_cyc;
 								else if (op_write)
 									state <= state_wdata_wait;
 								else
@@ -101,6 +147,10 @@ module wb_spis_master(
 								* so they state stable though the data phase */
 								byte_en <= spi_data[27:24];
 								addr    <= spi_data[23:0];
+
+								/* number of dummy boundaries, ceil(dummy / 4) - 1 */
+								pf_skip <= (op_fread && dummy != 4'h0) ? dummy[3:2] - {1'b0, (dummy[1:0] == 2'b00)} : 2'h0;
+								pf_late <= 1'b0;
 							end
 						end
 					
@@ -112,13 +162,52 @@ module wb_spis_master(
 						 */
 						if (ack_i) begin
 							addr <= addr + 24'h4;
-							state <= state_rdata_wait;
+							state <= pf_ok ? state_rpf_cyc : state_rdone;
 						end
 					end
 					
-				state_rdata_wait: begin
+				state_rdone: begin
+					/*
+					 * Register read done, hold here until chip select goes
+					 * up. The word after a register may be another
+					 * register with read side effects, it's never fetched.
+					 */
+				end
+
+				state_rpf_cyc: begin /* Prefetch Read */
+						/*
+						 * Fetch the word for the next boundary. Boundaries seen
+						 * here are dummy bytes, or, if the bus was held up for a
+						 * whole word, a missed slot. A missed slot goes out as
+						 * 0xDEADDEAD and its word is skipped so the following
+						 * words stay at the right address.
+						 */
+						if (boundary) begin
+							if (pf_skip != 2'h0)
+								pf_skip <= pf_skip - 2'h1;
+							else
+								pf_late <= 1'b1;
+						end
+
+						if (ack_i) begin
+							addr <= addr + 24'h4;
+							if (pf_late || (boundary && pf_skip == 2'h0)) begin
+								pf_late <= 1'b0;
+								if (!pf_ok)
+									state <= state_rdone;
+							end else begin
+								pf_data <= dat_i;
+								state <= state_rpf_wait;
+							end
+						end
+					end
+
+				state_rpf_wait: begin
 					if (boundary) begin
-							state <= state_rdata_cyc;
+						if (pf_skip != 2'h0)
+							pf_skip <= pf_skip - 2'h1;
+						else
+							state <= pf_ok ? state_rpf_cyc : state_rdone;
 					end
 				end
 			
@@ -0,0 +1,248 @@
+/* SPDX-License-Identifier: [MIT] */
+
+`timescale 1ns / 1ps
+
+/*
+ * SPI bridge read timing. A behavioral SPI master writes a block, then
+ * reads it back with the plain read and the turnaround read at several
+ * SPI clock ratios. The wishbone slave has a configurable number of wait
+ * states to stand in for bus arbitration.
+ */
+module wb_spis_master_tb();
+
+reg clk;
+
+reg spi_csn;
+reg spi_clk;
+reg spi_mosi;
+wire spi_miso;
+
+wire [23:0] wb_adr;
+wire [31:0] wb_dat_w;
+reg  [31:0] wb_dat_r;
+wire [3:0] wb_sel;
+wire wb_we;
+wire wb_cyc;
+wire wb_stb;
+reg  wb_ack;
+
+wb_spis_master dut(
+    .clk(clk),
+
+    .spi_csn(spi_csn),
+    .spi_clk(spi_clk),
+    .spi_mosi(spi_mosi),
+    .spi_miso(spi_miso),
+
+    .adr_o(wb_adr),
+    .dat_o(wb_dat_w),
+    .dat_i(wb_dat_r),
+    .sel_o(wb_sel),
+    .we_o(wb_we),
+    .cyc_o(wb_cyc),
+    .stb_o(wb_stb),
+    .ack_i(wb_ack)
+);
+
+initial begin
+    clk = 1'b1;
+    forever #10 clk = ~clk; // 20nS clock period
+end
+
+/*
+ * Wishbone memory, 256 words, acks after wait_states + 1 clocks. Reads
+ * in the register region (adr[22] == 1) are counted to check that they
+ * are never read ahead.
+ */
+reg [31:0] mem [0:255];
+integer wait_states;
+integer wait_cnt;
+integer reg_reads;
+
+always @(posedge clk) begin
+    wb_ack <= 1'b0;
+    if (wb_cyc && wb_stb && !wb_ack) begin
+        if (wait_cnt < wait_states) begin
+            wait_cnt <= wait_cnt + 1;
+        end else begin
+            wait_cnt <= 0;
+            wb_ack <= 1'b1;
+            wb_dat_r <= mem[wb_adr[9:2]];
+            if (wb_we)
+                mem[wb_adr[9:2]] <= wb_dat_w;
+            else if (wb_adr[22])
+                reg_reads <= reg_reads + 1;
+        end
+    end
+end
+
+/* SPI master, mode 0, half is half of a SPI clock period in nS */
+integer half;
+
+task spi_word(input [31:0] tx, output [31:0] rx);
+    integer i;
+    begin
+        for (i = 31; i >= 0; i = i - 1) begin
+            spi_mosi = tx[i];
+            #(half);
+            spi_clk = 1'b1;
+            rx[i] = spi_miso;
+            #(half);
+            spi_clk = 1'b0;
+        end
+    end
+endtask
+
+task spi_dummy(input integer nbytes);
+    integer i;
+    begin
+        spi_mosi = 1'b0;
+        for (i = 0; i < nbytes * 8; i = i + 1) begin
+            #(half);
+            spi_clk = 1'b1;
+            #(half);
+            spi_clk = 1'b0;
+        end
+    end
+endtask
+
+reg [31:0] rx;
+reg [31:0] rd [0:15];
+
+task spi_write(input [23:0] adr, input integer len);
+    integer i;
+    begin
+        spi_csn = 1'b0;
+        #(half);
+        spi_word({8'h0F, adr}, rx);
+        for (i = 0; i < len; i = i + 1)
+            spi_word(32'h1000_0000 * i + 32'h0001_0203 + adr, rx);
+        #(half);
+        spi_csn = 1'b1;
+        #(200);
+    end
+endtask
+
+/* opcode 1 when dummy is 0, opcode 2 otherwise */
+task spi_read(input [23:0] adr, input integer len, input integer dummy);
+    integer i;
+    begin
+        spi_csn = 1'b0;
+        #(half);
+        spi_word({(dummy == 0) ? 4'h1 : 4'h2, dummy[3:0], adr}, rx);
+        spi_dummy(dummy);
+        for (i = 0; i < len; i = i + 1) begin
+            spi_word(32'h0, rx);
+            rd[i] = rx;
+        end
+        #(half);
+        spi_csn = 1'b1;
+        #(200);
+    end
+endtask
+
+integer errors;
+
+task check(input [23:0] adr, input integer len, input integer dummy);
+    integer i;
+    integer bad;
+    begin
+        bad = 0;
+        spi_read(adr, len, dummy);
+        for (i = 0; i < len; i = i + 1) begin
+            if (rd[i] != mem[adr[9:2] + i])
+                bad = bad + 1;
+        end
+        $display("read  ratio %0d wait %0d dummy %0d len %0d: %0s (%0d bad, first 0x%08x)",
+                 2 * half / 20, wait_states, dummy, len,
+                 bad ? "FAIL" : "ok", bad, rd[0]);
+        errors = errors + bad;
+    end
+endtask
+
+initial begin
+    $dumpfile("wb_spis_master_tb.vcd");
+    $dumpvars;
+
+    spi_csn = 1'b1;
+    spi_clk = 1'b0;
+    spi_mosi = 1'b0;
+    wb_ack = 1'b0;
+    wait_states = 0;
+    wait_cnt = 0;
+    reg_reads = 0;
+    errors = 0;
+    #200
+
+    /* 1MHz, the rate the plain read was designed for */
+    half = 500;
+    spi_write(24'h000040, 16);
+    check(24'h000040, 16, 0);
+    check(24'h000040, 16, 1);
+
+    /*
+     * 6.25MHz, half a SPI clock is 4 system clocks. With a couple of wait
+     * states the plain read misses the first word, the burst behind it is
+     * prefetched and still lines up. Shown for reference, not counted.
+     */
+    half = 80;
+    wait_states = 2;
+    spi_read(24'h000040, 4, 0);
+    $display("read  ratio 8 wait 2 dummy 0 len 4: first 0x%08x second 0x%08x (plain read, reference)",
+             rd[0], rd[1]);
+
+    /* The turnaround read has a whole dummy byte to fetch the first word */
+    check(24'h000040, 16, 1);
+    check(24'h000044, 15, 2);
+    check(24'h000048, 8, 5);
+    check(24'h000040, 1, 1);
+
+    half = 100;
+    wait_states = 6;
+    check(24'h000040, 16, 1);
+    check(24'h000040, 16, 4);
+
+    /*
+     * Register region, only the addressed word may be read. The host reads
+     * registers one command per word.
+     */
+    half = 80;
+    wait_states = 2;
+    reg_reads = 0;
+    check(24'h400040, 1, 1);
+    check(24'h400044, 1, 1);
+    check(24'h400048, 1, 1);
+    $display("register reads: %0d (expect 3)", reg_reads);
+    if (reg_reads != 3)
+        errors = errors + 1;
+
+    /* A register burst reads the first word only, the rest is 0xDEADDEAD */
+    reg_reads = 0;
+    spi_read(24'h400040, 3, 1);
+    $display("register burst: %0d reads (expect 1), 0x%08x 0x%08x 0x%08x",
+             reg_reads, rd[0], rd[1], rd[2]);
+    if (reg_reads != 1 || rd[0] != mem[16] || rd[1] != 32'hDEADDEAD
+            || rd[2] != 32'hDEADDEAD)
+        errors = errors + 1;
+
+    /* Same for the plain read at the rate it was designed for */
+    half = 500;
+    wait_states = 0;
+    reg_reads = 0;
+    spi_read(24'h400040, 2, 0);
+    $display("register plain read: %0d reads (expect 1), 0x%08x 0x%08x",
+             reg_reads, rd[0], rd[1]);
+    if (reg_reads != 1 || rd[0] != mem[16] || rd[1] != 32'hDEADDEAD)
+        errors = errors + 1;
+    half = 80;
+    wait_states = 2;
+
+    /* Writes still work at the higher rate */
+    spi_write(24'h000080, 8);
+    check(24'h000080, 8, 1);
+
+    $display("%0s, %0d errors", errors ? "FAIL" : "PASS", errors);
+    $finish;
+end
+
+endmodule
@@ -0,0 +1,218 @@
+/* SPDX-License-Identifier: [MIT] */
+
+`default_nettype wire
+
+/*
+ * Direct mapped read cache in front of wb_sram. A read miss fills the
+ * whole line from word 0 up, which wb_sram streams without going idle
+ * between words, then acks. Writes go through to the sram and update the
+ * line if it's cached, so every bus master sees the same memory. A hit
+ * acks the clock after the request, as block RAM does.
+ *
+ * A miss or write works from the address, select and data latched at the
+ * request. If the requester drops cyc before the ack, as the SPI slave does
+ * when it abandons a read ahead, the sram cycles still finish but there is
+ * no ack and the line is left invalid, bussel may have granted the bus to
+ * another master by then.
+ *
+ * Control port:
+ * 0x0 = Control
+ *  [0]=invalidate all lines (write), [1]=clear hit/miss counters (write)
+ * 0x4 = Read hits
+ * 0x8 = Read misses, line fills
+ * 0xC = Geometry (read only)
+ *  [15:8]=log2 words per line, [7:0]=log2 lines
+ */
+module wb_sramcache #(
+	parameter LINES_LOG2 = 5,
+	parameter WORDS_LOG2 = 2
+)(
+	input clk,
+	input rst,
+
+	/* Cached sram, from the bus */
+	input  [16:0] 	adr_i,
+	input  [31:0] 	dat_i,
+	output [31:0] 	dat_o,
+	input  [3:0]  	sel_i,
+	input 			we_i,
+	input 			cyc_i,
+	input 			stb_i,
+	output 	reg 	ack_o,
+
+	/* Control registers */
+	input  [3:0] 	c_adr_i,
+	input  [31:0] 	c_dat_i,
+	output reg [31:0] c_dat_o,
+	input 			c_we_i,
+	input 			c_cyc_i,
+	input 			c_stb_i,
+	output 	reg 	c_ack_o,
+
+	/* To wb_sram */
+	output [16:0] 	m_adr_o,
+	output [31:0] 	m_dat_o,
+	input  [31:0] 	m_dat_i,
+	output [3:0]  	m_sel_o,
+	output 			m_we_o,
+	output 			m_cyc_o,
+	output 			m_stb_o,
+	input 			m_ack_i
+);
+
+	localparam LINES = 1 << LINES_LOG2;
+	localparam WORDS = 1 << WORDS_LOG2;
+	localparam TAG_W = 15 - LINES_LOG2 - WORDS_LOG2;
+	localparam [15:0] GEOMETRY = (WORDS_LOG2 << 8) | LINES_LOG2;
+
+	parameter [2:0] st_idle  = 3'b001;
+	parameter [2:0] st_fill  = 3'b010;
+	parameter [2:0] st_write = 3'b100;
+
+	reg [2:0] state = st_idle;
+
+	wire [WORDS_LOG2-1:0] offset = adr_i[WORDS_LOG2+1:2];
+	wire [LINES_LOG2-1:0] index  = adr_i[LINES_LOG2+WORDS_LOG2+1:WORDS_LOG2+2];
+	wire [TAG_W-1:0]      tag    = adr_i[16:LINES_LOG2+WORDS_LOG2+2];
+
+	/* The request being served by a fill or a write */
+	reg  [16:0] r_adr;
+	reg  [31:0] r_dat;
+	reg  [3:0]  r_sel;
+	reg         r_live;		// requester still in its cycle
+	wire [WORDS_LOG2-1:0] r_offset = r_adr[WORDS_LOG2+1:2];
+	wire [LINES_LOG2-1:0] r_index  = r_adr[LINES_LOG2+WORDS_LOG2+1:WORDS_LOG2+2];
+	wire [TAG_W-1:0]      r_tag    = r_adr[16:LINES_LOG2+WORDS_LOG2+2];
+
+	reg [31:0]      data [0:LINES*WORDS-1];
+	reg [TAG_W-1:0] tags [0:LINES-1];
+	reg [LINES-1:0] valid = 0;
+
+	wire req = cyc_i && stb_i && !ack_o;
+	wire hit = valid[index] && (tags[index] == tag);
+	wire r_hit = valid[r_index] && (tags[r_index] == r_tag);
+
+	/* Line fill word counter */
+	reg [WORDS_LOG2-1:0] fill;
+	wire fill_last = &fill;
+
+	/* Read data, from the cache or the word captured during a fill */
+	reg  [31:0] q;
+	reg  [31:0] fill_q;
+	reg         from_fill;
+	assign dat_o = from_fill ? fill_q : q;
+
+	/* Sram cycles, a fill reads the line in order */
+	assign m_cyc_o = (state != st_idle);
+	assign m_stb_o = m_cyc_o;
+	assign m_we_o  = (state == st_write);
+	assign m_sel_o = (state == st_write) ? r_sel : 4'hf;
+	assign m_dat_o = r_dat;
+	assign m_adr_o = (state == st_write) ? r_adr :
+						{r_tag, r_index, fill, 2'b00};
+
+	/* Cache write port, line fills and write hits */
+	wire fill_wr = (state == st_fill) && m_ack_i;
+	wire hit_wr  = (state == st_write) && m_ack_i && r_hit;
+	wire [LINES_LOG2+WORDS_LOG2-1:0] wr_adr = fill_wr ? {r_index, fill} : {r_index, r_offset};
+	wire [31:0] wr_dat = fill_wr ? m_dat_i : r_dat;
+	wire [3:0]  wr_sel = fill_wr ? 4'hf : r_sel;
+
+	always @ (posedge clk) begin
+		q <= data[{index, offset}];
+		if (fill_wr || hit_wr) begin
+			if (wr_sel[0]) data[wr_adr][7:0]   <= wr_dat[7:0];
+			if (wr_sel[1]) data[wr_adr][15:8]  <= wr_dat[15:8];
+			if (wr_sel[2]) data[wr_adr][23:16] <= wr_dat[23:16];
+			if (wr_sel[3]) data[wr_adr][31:24] <= wr_dat[31:24];
+		end
+	end
+
+	/* Control port */
+	reg [31:0] hits = 32'h0;
+	reg [31:0] misses = 32'h0;
+
+	wire c_acc   = c_cyc_i && c_stb_i && !c_ack_o;
+	wire c_wr    = c_acc && c_we_i && (c_adr_i[3:2] == 2'h0);
+	wire inval   = c_wr && c_dat_i[0];
+	wire c_clear = (c_wr && c_dat_i[1]) || rst;
+
+	always @ (posedge clk) begin
+		c_ack_o <= c_acc;
+		case (c_adr_i[3:2])
+			2'h0: c_dat_o <= 32'h0;
+			2'h1: c_dat_o <= hits;
+			2'h2: c_dat_o <= misses;
+			2'h3: c_dat_o <= {16'h0, GEOMETRY};
+		endcase
+	end
+
+	always @ (posedge clk) begin
+		ack_o <= 1'b0;
+
+		case (state)
+			st_idle: begin
+				r_adr  <= adr_i;
+				r_dat  <= dat_i;
+				r_sel  <= sel_i;
+				r_live <= 1'b1;
+				if (req && we_i) begin
+					state <= st_write;
+				end else if (req && hit) begin
+					hits <= hits + 32'h1;
+					from_fill <= 1'b0;
+					ack_o <= 1'b1;
+				end else if (req) begin
+					/* The line is overwritten from the first word */
+					misses <= misses + 32'h1;
+					valid[index] <= 1'b0;
+					fill <= 0;
+					state <= st_fill;
+				end
+			end
+
+			st_fill: begin
+				if (!cyc_i)
+					r_live <= 1'b0;
+				if (m_ack_i) begin
+					if (fill == r_offset)
+						fill_q <= m_dat_i;
+					fill <= fill + 1'b1;
+					if (fill_last) begin
+						tags[r_index] <= r_tag;
+						valid[r_index] <= r_live && cyc_i;
+						from_fill <= 1'b1;
+						ack_o <= r_live && cyc_i;
+						state <= st_idle;
+					end
+				end
+			end
+
+			st_write: begin
+				if (!cyc_i)
+					r_live <= 1'b0;
+				if (m_ack_i) begin
+					ack_o <= r_live && cyc_i;
+					state <= st_idle;
+				end
+			end
+
+			default:
+				state <= st_idle;
+		endcase
+
+		if (inval)
+			valid <= 0;
+
+		if (c_clear) begin
+			hits <= 32'h0;
+			misses <= 32'h0;
+		end
+
+		if (rst) begin
+			valid <= 0;
+			state <= st_idle;
+		end
+	end
+
+endmodule
@@ -0,0 +1,121 @@
+/* SPDX-License-Identifier: [MIT] */
+
+`default_nettype wire
+
+/*
+ * Compare-match timer, one compare register and interrupt per hart. The
+ * interrupt goes to the SERV timer input and stays asserted while mtime is
+ * at or past the hart's compare value, so the handler has to move the
+ * compare forward before it returns. The compare is wrap safe, it matches
+ * for up to 2^31 clocks after the compare value.
+ *
+ * 0x00 = mtime, system clocks [31:0] (read only)
+ *  A read also latches clocks [63:32] for the reading bus master. There
+ *  are no byte selects, read it as a whole word, every access latches.
+ * 0x04 = Compare for the accessing hart (read write)
+ * 0x08 = Advance the accessing hart's compare by the written value (write)
+ *  Adding the period in the handler keeps a periodic interrupt in phase,
+ *  however late the handler runs.
+ * 0x0C = System clocks [63:32], as latched by the last read of 0x00 (read
+ *  only). Each bus master has its own latch, so reading 0x00 then 0x0C
+ *  gives a consistent 64 bit count even with other masters doing the same.
+ * 0x10 = Microseconds, wraps after about 71 minutes (read only)
+ * 0x40 - 0x7C = Compare for hart 0 - 15 (read write), for the host
+ *
+ * The accessing hart is taken from the bussel busid, the SPI slave, CRC and
+ * DMA engines read 0 and can't write at 0x04 and 0x08.
+ */
+module wb_timer #(
+	parameter HARTS = 2,		/* up to 16 */
+	parameter MASTERS = HARTS + 2,
+	parameter CLK_MHZ = 50
+)(
+	input clk,
+	input rst,
+
+	input  [7:0] 	adr_i,
+	input  [31:0] 	dat_i,
+	output [31:0] 	dat_o,
+	input 			we_i,
+	input 			cyc_i,
+	input 			stb_i,
+	output 	reg 	ack_o,
+
+	/* Bus master ID, the harts are the lower bits */
+	input  [MASTERS-1:0]	busid,
+
+	/* Timer interrupts, one per hart */
+	output reg [HARTS-1:0]	irq,
+
+	/* Microsecond counter, for timestamps elsewhere */
+	output [31:0]	us_o
+);
+
+	reg [63:0] mtime = 64'h0;
+	reg [31:0] mtime_hi [0:MASTERS-1];
+	reg [31:0] us = 32'h0;
+	reg [7:0]  us_div = 8'h0;
+	assign us_o = us;
+	reg [31:0] cmp [0:HARTS-1];
+	reg [31:0] rdt;
+	reg [31:0] diff;
+
+	wire acc = cyc_i && stb_i && !ack_o;
+	wire own = (adr_i[7:2] == 6'h1) || (adr_i[7:2] == 6'h2);
+	wire any = (adr_i[7:6] == 2'h1);
+	wire [3:0] n = adr_i[5:2];
+
+	assign dat_o = rdt;
+
+	integer h;
+	initial begin
+		for (h = 0; h < HARTS; h = h + 1)
+			cmp[h] = 32'h0;
+		for (h = 0; h < MASTERS; h = h + 1)
+			mtime_hi[h] = 32'h0;
+		irq = 0;
+	end
+
+	always @ (posedge clk) begin
+		ack_o <= acc;
+		mtime <= mtime + 64'h1;
+
+		us_div <= (us_div == CLK_MHZ - 1) ? 8'h0 : us_div + 8'h1;
+		if (us_div == CLK_MHZ - 1)
+			us <= us + 32'h1;
+
+		rdt <= 32'h0;
+		if (adr_i[7:2] == 6'h0)
+			rdt <= mtime[31:0];
+		if (adr_i[7:2] == 6'h4)
+			rdt <= us;
+
+		for (h = 0; h < MASTERS; h = h + 1) begin
+			if (acc && !we_i && (adr_i[7:2] == 6'h0) && busid[h])
+				mtime_hi[h] <= mtime[63:32];
+			if ((adr_i[7:2] == 6'h3) && busid[h])
+				rdt <= mtime_hi[h];
+		end
+
+		for (h = 0; h < HARTS; h = h + 1) begin
+			if (acc && we_i && own && busid[h])
+				cmp[h] <= adr_i[3] ? cmp[h] + dat_i : dat_i;
+			else if (acc && we_i && any && (n == h))
+				cmp[h] <= dat_i;
+
+			if ((own && busid[h]) || (any && (n == h)))
+				rdt <= cmp[h];
+
+			/* Due once mtime is at or up to 2^31 clocks past compare */
+			diff = mtime[31:0] - cmp[h];
+			irq[h] <= !diff[31];
+		end
+
+		if (rst) begin
+			for (h = 0; h < HARTS; h = h + 1)
+				cmp[h] <= 32'h0;
+			irq <= 0;
+		end
+	end
+
+endmodule
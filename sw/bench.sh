@@ -0,0 +1,96 @@
+#!/bin/sh
+#
+# Firmware loop rate benchmark. Builds the programs listed in bench.conf
+# with -O2/-O0 and with/without link time optimization, runs each build in
+# the soc simulator (../sim) and writes clocks per loop iteration to
+# bench/report.tsv. Exits non-zero if any result is over its threshold,
+# a run that gave no loop figures is only reported, as nodata.
+#
+#   make bench
+#   LOOPS=1000 ./bench.sh
+#
+SIM=${SIM:-../sim/soc_sim}
+OUT=bench
+CONF=bench.conf
+LOOPS=${LOOPS:-200}
+WARMUP=200000       # 4mS, lets the R/C input lock before measuring
+TIMEOUT=100000000   # 2 seconds of simulated time
+VARIANTS="O2-lto O2-nolto O0-lto O0-nolto"
+
+if [ ! -x $SIM ]; then
+    echo "simulator not found: $SIM, run make in ../sim"
+    exit 1
+fi
+
+PROGS=$(grep -v '^#' $CONF | awk 'NF { print $1 }')
+mkdir -p $OUT
+
+# Build every variant, objects are shared so clean in between
+for v in $VARIANTS; do
+    case $v in
+        O2-lto)     flags="" ;;
+        O2-nolto)   flags="WITHOUT_LTO=1" ;;
+        O0-lto)     flags="WITHOUT_O2=1" ;;
+        O0-nolto)   flags="WITHOUT_O2=1 WITHOUT_LTO=1" ;;
+    esac
+    mkdir -p $OUT/$v
+    make clean > /dev/null 2>&1
+    for p in $PROGS; do
+        if ! make $flags $p.bin > $OUT/$v/$p.build 2>&1; then
+            echo "build failed: $p $v, see $OUT/$v/$p.build"
+            exit 1
+        fi
+        cp $p.bin $OUT/$v/
+    done
+done
+make clean > /dev/null 2>&1
+
+printf "program\tvariant\tloops\tclocks_per_loop\tloop_rate_hz\tthreshold\tresult\n" \
+    > $OUT/report.tsv
+
+grep -v '^#' $CONF | while read prog mask addr ppm t0 t1 t2 t3; do
+    [ -z "$prog" ] && continue
+    col=0
+    for v in $VARIANTS; do
+        case $col in
+            0) thr=$t0 ;; 1) thr=$t1 ;; 2) thr=$t2 ;; 3) thr=$t3 ;;
+        esac
+        col=$((col + 1))
+
+        $SIM --socket $OUT/sim.sock --bin $OUT/$v/$prog.bin --reset $mask \
+            --ppm $ppm --loop-addr $addr --warmup $WARMUP --loops $LOOPS \
+            --cycles $TIMEOUT > $OUT/$v/$prog.txt 2> /dev/null
+
+        loops=$(sed -n 's/^loop_count=//p' $OUT/$v/$prog.txt)
+        cpl=$(sed -n 's/^loop_cycles_avg=//p' $OUT/$v/$prog.txt)
+        rate=$(sed -n 's/^loop_rate_hz=//p' $OUT/$v/$prog.txt)
+
+        if [ -z "$cpl" ]; then
+            result=nodata
+            cpl=-
+            rate=-
+        elif [ "$thr" = "-" ]; then
+            result=ok
+        elif awk "BEGIN { exit !($cpl > $thr) }"; then
+            result=FAIL
+        else
+            result=ok
+        fi
+
+        printf "%s\t%s\t%s\t%s\t%s\t%s\t%s\n" $prog $v ${loops:-0} $cpl \
+            $rate $thr $result >> $OUT/report.tsv
+    done
+done
+
+column -t $OUT/report.tsv 2> /dev/null || cat $OUT/report.tsv
+
+if awk -F'\t' 'NR > 1 && $7 == "nodata" { n = 1 } END { exit !n }' $OUT/report.tsv; then
+    echo "some runs gave no data, see the .txt files under $OUT"
+fi
+
+# The loop above runs in a subshell, check the report for failures
+if awk -F'\t' 'NR > 1 && $7 == "FAIL" { bad = 1 } END { exit !bad }' $OUT/report.tsv; then
+    echo "benchmark regression, see $OUT/report.tsv"
+    exit 1
+fi
+exit 0
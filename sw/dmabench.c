@@ -0,0 +1,98 @@
+#include "rsio.h"
+
+/*
+ * DMA engine benchmark. Copies and fills a buffer in SRAM with a word
+ * loop on the hart, then with the DMA engine, and keeps the clocks per
+ * word each took in shared memory for the host:
+ *
+ *  0x47f0 = errors, DMA results that didn't match
+ *  0x47f4 = passes, the loop counter for bench.sh
+ *  0x47f8 = copy, [15:0]=hart, [31:16]=DMA clocks per word
+ *  0x47fc = fill, [15:0]=hart, [31:16]=DMA clocks per word
+ *
+ *     echo "read 0x47f0 4" | robotsoc-io -f -
+ *
+ * CPU0 runs the benchmark. The other harts spin, still fetching over the
+ * bus, hold them in reset for clean numbers.
+ */
+#define WORDS   64
+
+volatile uint8_t __attribute__((section (".hostmem")))
+    shared_mem[16];
+
+volatile uint32_t *errors = (uint32_t*)&(shared_mem[0]);
+volatile uint32_t *passes = (uint32_t*)&(shared_mem[4]);
+volatile uint16_t *clocks = (uint16_t*)&(shared_mem[8]);
+
+/* The DMA engine writes dst behind the compiler's back */
+static volatile uint32_t src[WORDS] SRAM_BSS;
+static volatile uint32_t dst[WORDS] SRAM_BSS;
+
+static void
+copy_words(volatile uint32_t *d, const volatile uint32_t *s, uint32_t n)
+{
+    while (n--)
+        *d++ = *s++;
+}
+
+static void
+fill_words(volatile uint32_t *d, uint32_t val, uint32_t n)
+{
+    while (n--)
+        *d++ = val;
+}
+
+static int
+check(uint32_t seed, uint32_t fill)
+{
+    int n;
+
+    for (n = 0; n < WORDS; n++) {
+        if (dst[n] != (fill ? seed : seed + n))
+            return 1;
+    }
+    return 0;
+}
+
+void
+main()
+{
+    uint32_t seed = 0x01010101;
+    uint32_t start;
+    int n;
+
+    if (rsio->hart != 1) {
+        while (1)
+            ;
+    }
+
+    while (1) {
+        for (n = 0; n < WORDS; n++)
+            src[n] = seed + n;
+
+        start = cycles();
+        copy_words(dst, src, WORDS);
+        clocks[0] = cycles_since(start) / WORDS;
+
+        fill_words(dst, 0, WORDS);
+        start = cycles();
+        dma_copy(dst, src, WORDS, 0);
+        dma_wait();
+        clocks[1] = cycles_since(start) / WORDS;
+        *errors += check(seed, 0);
+
+        start = cycles();
+        fill_words(dst, seed, WORDS);
+        clocks[2] = cycles_since(start) / WORDS;
+
+        fill_words(dst, 0, WORDS);
+        start = cycles();
+        dma_fill(dst, seed, WORDS);
+        dma_wait();
+        clocks[3] = cycles_since(start) / WORDS;
+        *errors += check(seed, 1);
+
+        seed += 0x01010101;
+        *passes += 1;
+    }
+}
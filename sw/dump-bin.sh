@@ -1,7 +1,8 @@
 #!/bin/sh
 
-./robotsoc-io -a 0x100000 -d 0x00000001
-./robotsoc-io -r $1
-
-# This causes the program to restart
-./robotsoc-io -a 0x100000 -d 0x00000000
+# Releasing reset at the end causes the program to restart
+./robotsoc-io -f - <<EOF
+reset 0x00000001
+dump  $1
+reset 0x00000000
+EOF
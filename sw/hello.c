@@ -17,66 +17,62 @@ scale(int x, int in_min, int in_max, int out_min, int out_max)
 
 volatile int counter = 0;
 
-void
-main(uint8_t id)
+/*
+ * 1kHz timer interrupt, the indicators toggle at fixed rates without the
+ * main loop polling anything.
+ */
+static uint32_t ms;
+static uint16_t last;
+
+static void
+tick(void)
 {
-    
-    mtimer_t d6;
-    mtimer_init(&d6, 2000);
+    uint16_t elapsed;
+
+    ms++;
 
-    mtimer_t d5;
-    mtimer_init(&d5, 1000);
+    /*
+     * Toggle indicator using hardware based xor function. Functionally
+     * this is the same as "gpo ^= 0x7" but generates 4 fewer instructions
+     */
+    if ((ms % 125) == 0)
+        rsio->gpio[0].wr.xor = 0x01;
 
-    mtimer_t d4;
-    mtimer_init(&d4, 500);
+    if ((ms % 250) == 0)
+        rsio->gpio[0].wr.xor = 0x02;
 
-    mtimer_t d3;
-    mtimer_init(&d3, 250);
+    if ((ms % 500) == 0)
+        rsio->gpio[0].wr.xor = 0x04;
 
-    mtimer_t d2;
-    mtimer_init(&d2, 125);
+    if ((ms % 1000) == 0)
+        rsio->gpio[0].wr.xor = 0x08;
 
-    mtimer_t d1;
-    mtimer_init(&d1, 10); // 100Hz
+    if ((ms % 2000) == 0)
+        rsio->gpio[0].wr.xor = 0x10;
 
+    if ((ms % 10) == 0) { // 100Hz
+        elapsed = rsio->tick - last;
+        last = rsio->tick;
+        if (elapsed != 10)
+            rsio->gpio[0].wr.set = 0x40;
+
+        counter++;
+        if ((counter & 0x7f) == 0x7f) {
+            rsio->gpio[0].wr.xor = 0x20;
+            shared_mem[1]++;
+        }
+    }
+}
+
+void
+main(uint8_t id)
+{
     rsio->gpio[0].wr.gpo = 0x0;
-    uint16_t elapsed;
-    uint16_t last = rsio->tick;
+    last = rsio->tick;
+    timer_periodic(tick, 1000);
+
     while (1) {
         shared_mem[3] = id;
         shared_mem[0]++;
-        
-        /*
-         * Toggle indicator using hardware based xor function. Functionally
-         * this is the same as "gpo ^= 0x7" but generates 4 fewer instructions
-         */
-        if (mtimer_timedout(&d2))
-            rsio->gpio[0].wr.xor = 0x01;
-
-        if (mtimer_timedout(&d3))
-            rsio->gpio[0].wr.xor = 0x02;
-
-        if (mtimer_timedout(&d4))
-            rsio->gpio[0].wr.xor = 0x04;
-
-        if (mtimer_timedout(&d5))
-            rsio->gpio[0].wr.xor = 0x08;
-
-        if (mtimer_timedout(&d6))
-            rsio->gpio[0].wr.xor = 0x10;
-
-        if (mtimer_timedout(&d1)) {
-            elapsed = rsio->tick - last;
-            last = rsio->tick;
-            if (elapsed != 10)
-                rsio->gpio[0].wr.set = 0x40;
-
-
-            counter++;
-            if ((counter & 0x7f) == 0x7f) {
-                rsio->gpio[0].wr.xor = 0x20;
-                shared_mem[1]++;
-            }
-        }
     }
 }
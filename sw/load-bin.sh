@@ -1,36 +1,56 @@
 #!/bin/sh
-cpumask="0x00000002"
+# Reset mask bit N holds hart N in reset, harts that don't exist ignore it.
+cpumask="0xfffffffe"
 
 case $1 in
     0)
-        # hold CPU1 in reset
-        cpumask="0x00000002"
+        # hold all but CPU0 in reset
+        cpumask="0xfffffffe"
         ;;
     1)
-        # hold CPU0 in reset
-        cpumask="0x00000001"
+        # hold all but CPU1 in reset
+        cpumask="0xfffffffd"
         ;;
     a)
         # hold no CPU in reset
         cpumask="0x00000000"
         ;;
+    0x*)
+        # explicit reset mask
+        cpumask=$1
+        ;;
     *)
         echo "usage:"
-        echo " $0 [0|1|a] image.bin"
+        echo " $0 [0|1|a|0xMASK] image.bin [image.sram.bin]"
         echo ""
         echo "invalid boot cpu specificed"
         echo "  specify one of"
         echo "  0 - boot CPU 0"
         echo "  1 - boot CPU 1"
-        echo "  a - boot both CPUs"
+        echo "  a - boot all CPUs"
+        echo "  0xMASK - hold the harts with a bit set in reset"
+        echo ""
+        echo "image.sram.bin is loaded into the external SRAM, it defaults"
+        echo "to the one built alongside image.bin if that isn't empty"
         exit 1
         ;;
 esac
 
-./robotsoc-io -a 0x100000 -d 0x00000003
-./robotsoc-io -l $2
-if [ "$?" != "0" ] ; then
-    exit $?
+sram=${3:-${2%.bin}.sram.bin}
+if [ -s "$sram" ]; then
+    sramload="delta $sram 0x800000"
+else
+    sramload=""
 fi
-./robotsoc-io -a 0x100000 -d $cpumask
+
+# Hold all CPUs in reset while loading, then release the boot CPU(s). Only
+# the words that differ from what's in BRAM or SRAM get written, the on-FPGA CRC32
+# engine verifies the result. The script stops at the first failing command,
+# a failed load or verify leaves the CPUs in reset.
+./robotsoc-io --verify=crc -f - <<EOF
+reset 0xffffffff
+delta $2
+$sramload
+reset $cpumask
+EOF
 
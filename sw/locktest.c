@@ -2,7 +2,7 @@
 
 volatile uint8_t __attribute__((section (".hostmem"))) shared_mem[16];
 
-spinlock_t lock;
+spinlock_t lock = SPINLOCK_INIT(0);
 
 void
 main()
@@ -0,0 +1,35 @@
+#include "rsio.h"
+
+/*
+ * Mailbox ping-pong. CPU0 sends a sequence number, CPU1 sends it back.
+ * The round trip count is kept in shared_mem[4], the loop rate benchmark
+ * (bench.sh) turns that into clocks per round trip. A wrong reply sets
+ * gpo bit 6, and shared_mem[0] counts them.
+ */
+volatile uint8_t __attribute__((section (".hostmem")))
+    shared_mem[16];
+
+volatile uint32_t *trips = (uint32_t*)&(shared_mem[4]);
+
+void
+main()
+{
+    uint32_t seq = 0;
+
+    if (rsio->hart != 1) {
+        /* CPU1, echo everything */
+        while (1)
+            mbox_send(mbox_recv());
+    }
+
+    rsio->gpio[0].wr.gpo = 0x0;
+    while (1) {
+        mbox_send(seq);
+        if (mbox_recv() != seq) {
+            rsio->gpio[0].wr.set = 0x40;
+            shared_mem[0]++;
+        }
+        seq++;
+        *trips = seq;
+    }
+}
@@ -1,6 +1,12 @@
 #include "rsio.h"
 
 volatile rsio_t * const rsio = (rsio_t*)0x400000;
+volatile rsio_perf_t * const rsio_perf = (rsio_perf_t*)0xC30000;
+volatile uint32_t * const rsio_hwlock = (uint32_t*)0xC40000;
+volatile rsio_mbox_t * const rsio_mbox = (rsio_mbox_t*)0xC50000;
+volatile rsio_timer_t * const rsio_timer = (rsio_timer_t*)0xC60000;
+volatile rsio_sram_cache_t * const rsio_sram_cache = (rsio_sram_cache_t*)0xC70000;
+volatile rsio_dma_t * const rsio_dma = (rsio_dma_t*)0xC80000;
 
 void
 mtimer_init(mtimer_t *t, uint16_t ms)
@@ -28,28 +34,264 @@ mtimer_timedout(mtimer_t *t)
     return 0;
 }
 
+void
+mtimer_us_init(mtimer_us_t *t, uint32_t us)
+{
+    t->us = us;
+    t->last = rsio_timer->us;
+}
+
+void
+mtimer_us_reset(mtimer_us_t *t)
+{
+    t->last = rsio_timer->us;
+}
+
+int
+mtimer_us_timedout(mtimer_us_t *t)
+{
+    uint32_t now = rsio_timer->us;
+
+    if (now - t->last >= t->us) {
+        t->last = now;
+        return 1;
+    }
+    return 0;
+}
+
+/*
+ * The mtime read latches the upper half for this hart, mtime_hi is
+ * consistent with it even if the count carries in between. Both have to
+ * be single word loads, a byte load of mtime would latch again.
+ */
+uint64_t
+cycles64(void)
+{
+    uint32_t lo = rsio_timer->mtime;
+
+    return ((uint64_t)rsio_timer->mtime_hi << 32) | lo;
+}
+
+/*
+ * Performance counters. The snapshot is shared by both harts and the host.
+ */
+void
+perf_snapshot(void)
+{
+    rsio_perf->ctl = PERF_SNAPSHOT;
+}
+
+void
+perf_clear(void)
+{
+    rsio_perf->ctl = PERF_SNAPSHOT | PERF_CLEAR;
+}
+
+/*
+ * R/C receiver capture. One read per call, the read clears the flag.
+ */
+int
+ppm_fresh(int ch, uint16_t *pos)
+{
+    /* rsio_t is packed, a word pointer keeps this to a single load */
+    volatile uint32_t *ppm = (volatile uint32_t *)rsio->ppm;
+    uint32_t w = ppm[ch];
+
+    if (!(w & PPM_NEW))
+        return 0;
+    *pos = PPM_POS(w);
+    return 1;
+}
+
+/*
+ * Skew free PWM update, both words are staged before the commit.
+ */
+void
+pwm_update(uint32_t lo, uint32_t hi)
+{
+    volatile uint32_t *pwmo = (volatile uint32_t *)rsio->pwmo;
+
+    pwmo[0] = lo;
+    pwmo[1] = hi;
+    rsio->pwm_ctl |= PWM_COMMIT;
+}
+
+/*
+ * PPM to PWM mixer.
+ */
+void
+mix_bridge(int fwd, int rev, int ppmi, uint8_t deadband, uint16_t gain)
+{
+    uint32_t cfg = MIX_EN | MIX_SRC(ppmi) | MIX_DEADBAND(deadband) |
+        MIX_GAIN(gain);
+
+    rsio->mix[fwd] = cfg;
+    rsio->mix[rev] = cfg | MIX_REV;
+}
+
+void
+mix_off(int pwm)
+{
+    rsio->mix[pwm] = 0;
+}
+
+/*
+ * SRAM cache. Bus writes keep cached lines up to date, invalidating is for
+ * starting over with a cold cache, as when timing SRAM code.
+ */
+void
+sram_cache_invalidate(void)
+{
+    rsio_sram_cache->ctl = SRAM_CACHE_INVALIDATE;
+}
+
+void
+sram_cache_clear(void)
+{
+    rsio_sram_cache->ctl = SRAM_CACHE_CLEAR;
+}
+
+/*
+ * DMA engine. Each call waits out the transfer before it, then starts its
+ * own and returns, dma_wait() for the end of it. 'flags' for dma_copy()
+ * are DMA_SRC_FIXED and DMA_DST_FIXED, a fixed address doesn't advance.
+ */
+void
+dma_copy(volatile void *dst, const volatile void *src, uint32_t words,
+    uint32_t flags)
+{
+    dma_wait();
+    rsio_dma->src = (uintptr_t)src;
+    rsio_dma->dst = (uintptr_t)dst;
+    rsio_dma->len = words;
+    rsio_dma->ctl = DMA_COPY | (flags & (DMA_SRC_FIXED | DMA_DST_FIXED)) |
+        DMA_START;
+}
+
+void
+dma_fill(volatile void *dst, uint32_t val, uint32_t words)
+{
+    dma_wait();
+    rsio_dma->dst = (uintptr_t)dst;
+    rsio_dma->fill = val;
+    rsio_dma->len = words;
+    rsio_dma->ctl = DMA_FILL | DMA_START;
+}
+
+void
+dma_list(const rsio_dma_desc_t *list, uint32_t n)
+{
+    dma_wait();
+    rsio_dma->src = (uintptr_t)list;
+    rsio_dma->len = n;
+    rsio_dma->ctl = DMA_LIST | DMA_START;
+}
+
+/* Stops after the bus cycle under way, the rest of the transfer is lost */
+void
+dma_stop(void)
+{
+    rsio_dma->ctl = DMA_STOP;
+    dma_wait();
+}
+
+/*
+ * Mailbox to the other hart, both calls may stall the hart.
+ */
+void
+mbox_send(uint32_t msg)
+{
+    rsio_mbox->data = msg;
+}
+
+uint32_t
+mbox_recv(void)
+{
+    return rsio_mbox->data;
+}
+
+int
+mbox_pending(void)
+{
+    return rsio_mbox->pending;
+}
+
+/*
+ * Periodic timer interrupt, handler and period in clocks per hart.
+ */
+static timer_handler_t timer_fn[8];
+static uint32_t timer_period[8];
+
+void
+timer_periodic(timer_handler_t fn, uint32_t us)
+{
+    int h = __builtin_ctz(rsio->hart);
+
+    csr_clear(mie, CSR_MIE_MTIE);
+    if (!fn)
+        return;
+
+    timer_fn[h] = fn;
+    timer_period[h] = us * (TIMER_HZ / 1000000);
+    rsio_timer->cmp = rsio_timer->mtime + timer_period[h];
+    csr_set(mie, CSR_MIE_MTIE);
+    csr_set(mstatus, CSR_MSTATUS_MIE);
+}
+
+/*
+ * Trap entry, the startup code points mtvec here. Only the timer interrupt
+ * is enabled, moving the compare forward by a period before running the
+ * handler keeps the rate fixed however long the handler takes. Exceptions
+ * stop here.
+ */
+void __attribute__((interrupt("machine"), aligned(4), used))
+trap_entry(void)
+{
+    int h;
+
+    if (!(csr_read(mcause) & CSR_MCAUSE_IRQ))
+        for (;;)
+            ;
+
+    h = __builtin_ctz(rsio->hart);
+    rsio_timer->add = timer_period[h];
+    timer_fn[h]();
+}
+
+static inline volatile uint32_t *
+spinlock_reg(spinlock_t *l)
+{
+    return &rsio_hwlock[l->id & (HWLOCK_COUNT - 1)];
+}
 
 void
 spinlock_lock(spinlock_t *l)
 {
-    /* Compute CPU index from on-hot processor ID */
-    uint8_t i = (rsio->hart >> 1);
-    uint8_t o = i ^ 1;
-    l->flag[i] = 1;
-    l->turn = o;
-    while ((l->flag[o] == 1) && (l->turn == o)) {
+    volatile uint32_t *r = spinlock_reg(l);
+    while (*r) {
 #ifdef SPINLOCK_PROFILE
-        l->wait[i]++;
+        /* Compute CPU index from on-hot processor ID */
+        l->wait[__builtin_ctz(rsio->hart)]++;
 #else
         ;
 #endif
     }
+    /* Keep the compiler from moving accesses out of the critical section */
+    __asm__ volatile ("" ::: "memory");
+}
+
+/* Returns 1 if the lock was taken */
+int
+spinlock_trylock(spinlock_t *l)
+{
+    int taken = (*spinlock_reg(l) == 0);
+    __asm__ volatile ("" ::: "memory");
+    return taken;
 }
 
 void
 spinlock_unlock(spinlock_t *l)
 {
-    uint8_t i = (rsio->hart >> 1);
-    l->flag[i] = 0;
+    __asm__ volatile ("" ::: "memory");
+    *spinlock_reg(l) = 0;
 }
-
@@ -5,7 +5,8 @@
 
 /* 
  * 0x400000 = Status, millisecond counter (read only)
- *  [31]=ebrake, [30:20]=unused, [19:16]=hart, [15:0]=count
+ *  [31]=ebrake, [30:24]=unused, [23:16]=hart, [15:0]=count
+ *  hart is one-hot, bit N reads as set on hart N
  *
  * 0x400004 = R/C Receiver PPM input, 2x channels (read only)
  *  [24]=ch1 locked, [23:16]=ch1, [8]=ch0 locked, [7:0]=ch0
@@ -30,6 +31,33 @@
  *
  * 0x40001C = Reserved for 4x 8-bit pulse counters
  *
+ * 0x400020 - 0x40003C = PPM to PWM mixer, one word per PWM channel
+ *  [27:16]=gain Q4.8, [15:8]=deadband, [6:4]=ppmi input,
+ *  [1]=reverse side, [0]=enable
+ *  See source/ppmmix.v. An enabled channel is written with the scaled
+ *  ppmi value on every new sample, firmware writes hold until the next.
+ *  ppmi inputs 0 - 7 are the capture channels below.
+ *
+ * 0x400040 = R/C receiver capture control (read write)
+ *  [1]=PPM-sum pin, [0]=PPM-sum mode, 8 channels from one pin
+ *
+ * 0x400044 = R/C receiver capture flags (read only)
+ *  [15:8]=locked, [7:0]=new sample, one bit per channel
+ *
+ * 0x400060 - 0x40007C = R/C receiver channels 0 - 7 (read only)
+ *  [31:16]=timestamp in uS, [15]=new sample, [14]=locked,
+ *  [11:0]=position, 2048 = center, 16x the resolution of 0x400004
+ *  See source/ppmcap.v. Reading a channel clears its new sample flag,
+ *  without PPM-sum mode channels 0 and 1 are the two ppmi pins.
+ *
+ * 0x400080 = PWM control (read write)
+ *  [15:8]=prescaler, [5:4]=resolution, [1]=commit, [0]=shadow
+ *  PWM frequency is 50MHz / (2^(12 - resolution) * (prescaler + 1)),
+ *  12.2KHz by default. In shadow mode channel writes at 0x400010 and
+ *  0x400014 wait for a commit, then all 8 channels change together at the
+ *  next counter turnaround. Commit reads 1 until then. Mixer updates
+ *  commit on their own.
+ *
  */
 
 typedef struct {
@@ -76,15 +104,104 @@ typedef struct {
     rsio_ppmo_t ppmo[8];
     rsio_pwmo_t pwmo[8];
     rsio_gpio_t gpio[1];
+    uint32_t    _pcnt;
+
+    uint32_t    mix[8];
+
+    uint32_t    ppm_ctl;
+    uint32_t    ppm_flags;
+    uint32_t    _r0[6];
+    uint32_t    ppm[8];         /* reading clears PPM_NEW, see ppm_fresh() */
+
+    uint32_t    pwm_ctl;
 
 } __attribute__((packed)) rsio_t;
 
+/* PWM control, rsio->pwm_ctl */
+#define PWM_SHADOW          (1 << 0)
+#define PWM_COMMIT          (1 << 1)
+#define PWM_RES(n)          (((n) & 0x3) << 4)  /* 11 - n counter bits */
+#define PWM_PRESCALE(n)     (((n) & 0xff) << 8)
+
+/*
+ * Set all 8 PWM channels at once, channel N in byte N % 4 of lo (0 - 3) or
+ * hi (4 - 7). Needs PWM_SHADOW, the new values go out together at the
+ * next counter turnaround.
+ */
+void pwm_update(uint32_t lo, uint32_t hi);
+
+/* R/C receiver capture, rsio->ppm_ctl and rsio->ppm[channel] */
+#define PPM_SUM             (1 << 0)
+#define PPM_SUM_PIN(pin)    (((pin) & 0x1) << 1)
+
+#define PPM_NEW             (1 << 15)
+#define PPM_LOCK            (1 << 14)
+#define PPM_POS(w)          ((w) & 0xfff)
+#define PPM_TS(w)           ((uint16_t)((w) >> 16))
+#define PPM_CENTER          2048
+
+/*
+ * Fresh R/C input. Returns 1 and the channel's position if a sample came
+ * in since the last read of that channel, 0 otherwise.
+ */
+int ppm_fresh(int ch, uint16_t *pos);
+
+/* Mixer config, rsio->mix[pwm channel] */
+#define MIX_EN              (1 << 0)
+#define MIX_REV             (1 << 1)
+#define MIX_SRC(ppmi)       (((ppmi) & 0x7) << 4)
+#define MIX_DEADBAND(db)    (((db) & 0xff) << 8)
+#define MIX_GAIN(q48)       (((q48) & 0xfff) << 16)
+
+/*
+ * Drive a full bridge from a ppmi input, 'fwd' takes the input above
+ * center and 'rev' below it. gain is Q4.8, 256 = 1.0.
+ */
+void mix_bridge(int fwd, int rev, int ppmi, uint8_t deadband, uint16_t gain);
+void mix_off(int pwm);
+
 /*
  * This doesn't get optimized out when defined in this manner unless link time
  * optimization is enabled.
  */
 extern volatile rsio_t * const rsio;
 
+/*
+ * 0xC30000 = Performance counters, see source/wb_perf.v
+ *
+ * Counters run all the time, reads return the values at the last snapshot.
+ *
+ * The system peripherals from here on ignore byte selects. Their register
+ * blocks are plain structs of aligned words, so every access is a single
+ * word load or store, a packed struct would be split into byte accesses.
+ */
+#define PERF_SNAPSHOT   0x1
+#define PERF_CLEAR      0x2
+
+typedef struct {
+    uint32_t    cycles;     /* clocks out of reset */
+    uint32_t    insns;      /* instructions retired */
+    uint32_t    ibus;       /* clocks fetching instructions */
+    uint32_t    dbus;       /* clocks in loads & stores */
+    uint32_t    wait;       /* clocks waiting for a bus grant */
+    uint32_t    _r[3];
+} rsio_perf_hart_t;
+
+typedef struct {
+    uint32_t    ctl;
+    uint32_t    harts;      /* number of harts */
+    uint32_t    _r0[2];
+    uint32_t    spi_cycles; /* SPI slave bus cycles */
+    uint32_t    spi_wait;   /* SPI slave clocks waiting for a bus grant */
+    uint32_t    _r1[2];
+    rsio_perf_hart_t hart[8];   /* 'harts' are implemented */
+} rsio_perf_t;
+
+extern volatile rsio_perf_t * const rsio_perf;
+
+void perf_snapshot(void);
+void perf_clear(void);
+
 
 /*
  * Non-blocking millisecond timer.
@@ -99,17 +216,241 @@ void mtimer_reset(mtimer_t *t);
 int mtimer_timedout(mtimer_t *t);
 
 /*
- * Spin-lock, Peterson's Algorithm - Works with 2 CPUs only.
+ * Non-blocking microsecond timer, for sub-millisecond loops. Timeouts up
+ * to 2^31 us.
+ */
+typedef struct {
+    uint32_t us;
+    uint32_t last;
+} mtimer_us_t;
+
+void mtimer_us_init(mtimer_us_t *t, uint32_t us);
+void mtimer_us_reset(mtimer_us_t *t);
+int mtimer_us_timedout(mtimer_us_t *t);
+
+/*
+ * 0xC40000 = Hardware locks, see source/wb_hwlock.v
+ *
+ * Reading a lock register takes the lock if it's free and returns 0,
+ * otherwise it returns the holder's bus ID. Writing releases it. Locks
+ * a hart holds are released while it's held in reset.
+ */
+#define HWLOCK_COUNT    32
+
+extern volatile uint32_t * const rsio_hwlock;
+
+/*
+ * 0xC50000 = Mailboxes between the harts, see source/wb_mailbox.v
+ *
+ * Each hart sees its own end. Sending waits while the other hart's FIFO is
+ * full, receiving waits until a message arrives. Waiting stalls the hart
+ * on its private mailbox port, the shared bus stays free. Only harts 0 and 1
+ * have a mailbox.
+ */
+typedef struct {
+    uint32_t    data;
+    uint8_t     pending;    /* messages waiting */
+    uint8_t     room;       /* free slots towards the other hart */
+    uint16_t    _r;
+} rsio_mbox_t;
+
+extern volatile rsio_mbox_t * const rsio_mbox;
+
+void mbox_send(uint32_t msg);
+uint32_t mbox_recv(void);
+int mbox_pending(void);
+
+/*
+ * 0xC60000 = Hart timers, see source/wb_timer.v
+ *
+ * A compare-match timer per hart on the SERV timer interrupt. cmp and add
+ * act on the accessing hart's own compare register.
+ */
+typedef struct {
+    uint32_t    mtime;      /* system clocks, latches mtime_hi */
+    uint32_t    cmp;        /* interrupt once mtime reaches this */
+    uint32_t    add;        /* write only, advances cmp */
+    uint32_t    mtime_hi;   /* clocks [63:32] at the last mtime read */
+    uint32_t    us;         /* microseconds */
+    uint32_t    _r[11];
+    uint32_t    hart_cmp[16];
+} rsio_timer_t;
+
+extern volatile rsio_timer_t * const rsio_timer;
+
+#define TIMER_HZ        50000000
+#define TIMER_PER_US    (TIMER_HZ / 1000000)
+
+/* System clocks since configuration, the full 64 bits never wrap */
+uint64_t cycles64(void);
+
+/*
+ * Cheap section timing, start = cycles() then cycles_since(start). Good for
+ * sections up to 85 seconds long.
+ */
+static inline uint32_t
+cycles(void)
+{
+    return rsio_timer->mtime;
+}
+
+static inline uint32_t
+cycles_since(uint32_t start)
+{
+    return rsio_timer->mtime - start;
+}
+
+/*
+ * Periodic timer interrupt. The handler runs every 'us' microseconds on the
+ * calling hart, with interrupts off. Each hart has its own handler, a NULL
+ * handler stops the calling hart's timer.
+ */
+typedef void (*timer_handler_t)(void);
+
+void timer_periodic(timer_handler_t fn, uint32_t us);
+
+/* Machine mode CSR access */
+#define CSR_MSTATUS_MIE     (1 << 3)
+#define CSR_MIE_MTIE        (1 << 7)
+#define CSR_MCAUSE_IRQ      (1u << 31)
+
+#define csr_read(csr) ({ uint32_t __v; \
+    __asm__ volatile ("csrr %0, " #csr : "=r" (__v)); __v; })
+#define csr_set(csr, bits) \
+    __asm__ volatile ("csrs " #csr ", %0" :: "r" (bits) : "memory")
+#define csr_clear(csr, bits) \
+    __asm__ volatile ("csrc " #csr ", %0" :: "r" (bits) : "memory")
+
+/*
+ * 0x800000 = External SRAM, 128KB, see the .sram sections in machine.ld
+ *
+ * Place code that rarely runs, tables and large buffers there. SRAM_BSS
+ * variables start out with whatever the SRAM holds.
+ */
+#define SRAM_TEXT   __attribute__((section(".sram.text"), noinline))
+#define SRAM_RODATA __attribute__((section(".sram.rodata")))
+#define SRAM_DATA   __attribute__((section(".sram.data")))
+#define SRAM_BSS    __attribute__((section(".sram.bss")))
+
+/*
+ * Lookup table scaling. 256 entry transfer curves, generated from a config
+ * file by tools/lutgen.c, see the %_lut.c rule in the Makefile. The .lut
+ * section in machine.ld keeps the tables in block RAM, mapping a channel
+ * is one byte load.
+ */
+typedef struct {
+    uint8_t     v[256];
+} rsio_lut_t;
+
+#define RSIO_LUT    __attribute__((section(".lut")))
+
+static inline uint8_t
+lut_map(const rsio_lut_t *t, uint8_t in)
+{
+    return t->v[in];
+}
+
+/*
+ * 0xC70000 = SRAM cache control, see source/wb_sramcache.v
+ *
+ * Reads from the SRAM go through a direct mapped cache, writes go through
+ * to the SRAM and update cached lines.
+ */
+#define SRAM_CACHE_INVALIDATE   0x1
+#define SRAM_CACHE_CLEAR        0x2
+
+typedef struct {
+    uint32_t    ctl;        /* write only */
+    uint32_t    hits;       /* reads answered by the cache */
+    uint32_t    misses;     /* reads that filled a line */
+    uint8_t     lines_log2;
+    uint8_t     words_log2; /* words per line */
+    uint16_t    _r;
+} rsio_sram_cache_t;
+
+extern volatile rsio_sram_cache_t * const rsio_sram_cache;
+
+void sram_cache_invalidate(void);
+void sram_cache_clear(void);
+
+/*
+ * 0xC80000 = DMA engine, see source/wb_dma.v
+ *
+ * Copies and fills words, or writes a list of registers on a timetable,
+ * while the harts get on with something else. Addresses are bus addresses,
+ * word aligned, the DMA takes turns on the bus with the harts. One transfer
+ * at a time, harts sharing the engine need a lock around it.
+ */
+#define DMA_START       0x001
+#define DMA_BUSY        0x001
+#define DMA_STOP        0x002
+#define DMA_COPY        0x000
+#define DMA_FILL        0x010
+#define DMA_LIST        0x020
+#define DMA_SRC_FIXED   0x100
+#define DMA_DST_FIXED   0x200
+
+typedef struct {
+    uint32_t    src;        /* source, or descriptor list */
+    uint32_t    dst;
+    uint32_t    len;        /* words, or descriptors */
+    uint32_t    ctl;
+    uint32_t    fill;
+    uint32_t    remain;     /* read only */
+} rsio_dma_t;
+
+extern volatile rsio_dma_t * const rsio_dma;
+
+/*
+ * List mode descriptor, write 'data' to register 'adr' after waiting 'ms'
+ * milliseconds, up to 255.
+ */
+typedef struct {
+    uint32_t    adr;
+    uint32_t    data;
+} rsio_dma_desc_t;
+
+#define DMA_DESC(ms, adr, data) \
+    { ((uint32_t)(ms) << 24) | ((uint32_t)(adr) & 0xfffffc), (data) }
+
+void dma_copy(volatile void *dst, const volatile void *src, uint32_t words,
+    uint32_t flags);
+void dma_fill(volatile void *dst, uint32_t val, uint32_t words);
+void dma_list(const rsio_dma_desc_t *list, uint32_t n);
+void dma_stop(void);
+
+static inline int
+dma_busy(void)
+{
+    return rsio_dma->ctl & DMA_BUSY;
+}
+
+static inline void
+dma_wait(void)
+{
+    while (dma_busy())
+        ;
+}
+
+/*
+ * Spin-lock, backed by a hardware lock register so waiting doesn't touch
+ * memory. Each lock names its register, 0 to HWLOCK_COUNT - 1, with
+ * SPINLOCK_INIT. Locks given the same index are one lock, a lock left
+ * zeroed uses register 0.
+ *
+ *  spinlock_t tlm_lock = SPINLOCK_INIT(3);
  */
 typedef volatile struct {
-    uint8_t flag[2];
+    uint32_t id;
 #ifdef SPINLOCK_PROFILE
-    uint8_t wait[2];
+    uint32_t wait[8];
 #endif
-    uint8_t turn;
 } spinlock_t;
 
+#define SPINLOCK_INIT(n)    { .id = (n) }
+
 void spinlock_lock(spinlock_t *l);
+int spinlock_trylock(spinlock_t *l);
 void spinlock_unlock(spinlock_t *l);
 
 
@@ -0,0 +1,40 @@
+/* Servo PWM mixer Test
+ *
+ * Same throttle path as servopwmscale, done by the gio mixer instead of
+ * the CPU. The hart writes the mixer config once, after that every new
+ * R/C receiver pulse updates the h-bridge drive on its own.
+ */
+
+#include "rsio.h"
+
+volatile uint8_t __attribute__((section (".hostmem")))
+    shared_mem[16];
+
+volatile uint32_t *cntr = (uint32_t*)&(shared_mem[4]);
+
+#define PPMI_THR 1
+#define PWMO_FWD 0
+#define PWMO_REV 1
+
+/*
+ * Dead band 124 < val < 132, and the Q8.4 gain of servopwmscale, 41/16 =
+ * 2.5625, as Q4.8. Takes the DX2E throttle range to 100% modulation.
+ */
+#define THR_DEADBAND    4
+#define THR_GAIN        656
+
+void
+main(uint8_t id)
+{
+    mix_bridge(PWMO_FWD, PWMO_REV, PPMI_THR, THR_DEADBAND, THR_GAIN);
+
+    while (1) {
+        /* Debug info, host system access */
+        shared_mem[0] = rsio->pwmo[PWMO_FWD].val;
+        shared_mem[1] = rsio->pwmo[PWMO_REV].val;
+        shared_mem[2] = rsio->ppmi[PPMI_THR].val;
+        shared_mem[3] = 0xAA;
+
+        *cntr += 1;
+    }
+}
@@ -5,6 +5,7 @@
  */
 
 #include "rsio.h"
+#include "servopwmscale_lut.h"
 
 volatile uint8_t __attribute__((section (".hostmem")))
     shared_mem[16];
@@ -51,45 +52,26 @@ main(uint8_t id)
          * disables drive signal if no updates occur within ~160mS
          */
         if (rsio->ppmi[PPMI_THR].sts) {
-            volatile uint8_t v = rsio->ppmi[PPMI_THR].val;
-            uint32_t tmp;
+            uint8_t v = rsio->ppmi[PPMI_THR].val;
             /*
              * Idle throttle = 0x80
              * fwd --> val > 0x80
              * rev --> val < 0x80
              *
-             * Scaling function
-             * fwd, 0x80 < val < 0xff --> 0-100% modulation
-             * rev, 0x7f > val > 0x00 --> 0-100% modulation
-             *
-             * See note above about transmitter range. This sign/magnitude
-             * conversion would only get to about 75% pulse width modulation
-             * on the throttle drive signals without linear scaling due to the
-             * DX2E transmitter.
+             * Dead band, gain and clamp come from the curves in
+             * servopwmscale.lut, see tools/lutgen.c. The gain takes the
+             * DX2E throttle range, see note above, to 100% modulation.
              */
+            uint8_t fwd = lut_map(&lut_fwd, v);
+            uint8_t rev = lut_map(&lut_rev, v);
 
-            /* Dead band */
-            if (v > 124 && v < 132) {
-                rsio->pwmo[PWMO_FWD].val = 0;
+            /* Turn the idle side off first, never drive both */
+            if (fwd) {
                 rsio->pwmo[PWMO_REV].val = 0;
-            /* Forward */
-            } else if (v >= 0x80) {
-                /* Q8.4 format, 41 = 2.5625 */
-                tmp = (((v - 128) << 4) * 41) >> 8;
-                if (tmp > 255)
-                    tmp = 255;
-
-                rsio->pwmo[PWMO_REV].val = 0;
-                rsio->pwmo[PWMO_FWD].val = (uint8_t)tmp;
-            /* Reverse */
+                rsio->pwmo[PWMO_FWD].val = fwd;
             } else {
-                /* Q8.4 format, 41 = 2.5625 */
-                tmp = (((128 - v) << 4) * 41) >> 8;
-                if (tmp > 255)
-                    tmp = 255;
-
                 rsio->pwmo[PWMO_FWD].val = 0;
-                rsio->pwmo[PWMO_REV].val = (uint8_t)tmp;
+                rsio->pwmo[PWMO_REV].val = rev;
             }
         }
 
@@ -102,7 +84,8 @@ main(uint8_t id)
         /*
          * Counter used for rough approximation of loop iterations per second
          * when throttle fully engaged.
-         * ~12218 per second | -O2 and link time optimization
+         * ~12218 per second | -O2 and link time optimization, with the
+         * Q8.4 multiply these tables replace
          *
          * Computed on host interface by reading counter, sleeping 10 sec,
          * reading again, compute delta then divide by 10.
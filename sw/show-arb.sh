@@ -0,0 +1,51 @@
+#!/bin/sh
+
+# Bus arbiter statistics over an interval, default 1000ms. Clears the
+# counters, waits, then prints bus cycles and wait clocks per bus master.
+ms=${1:-1000}
+
+# Bus masters are the harts, then the SPI slave, the CRC and DMA engines and
+# the telemetry sampler
+harts=$(./robotsoc-io -a 0xC30004 | sed 's/.*=//')
+if [ -z "$harts" ]; then
+    echo "unable to read the hart count"
+    exit 1
+fi
+harts=$((harts))
+masters=$((harts + 4))
+
+set -- $(./robotsoc-io -f - <<EOF2 | sed 's/.*=//'
+write 0xC20084 1
+sleep $ms
+read  0xC20000 $masters
+read  0xC20040 $masters
+read  0xC20080 1
+EOF2
+)
+
+if [ $# -ne $((masters * 2 + 1)) ]; then
+    echo "unable to read arbiter statistics"
+    exit 1
+fi
+
+printf "%-5s %10s %10s\n" "" "cycles" "wait"
+m=0
+while [ $m -lt $masters ]; do
+    if [ $m -lt $harts ]; then
+        name="hart$m"
+    elif [ $m -eq $harts ]; then
+        name="spi"
+    elif [ $m -eq $((harts + 1)) ]; then
+        name="crc"
+    elif [ $m -eq $((harts + 2)) ]; then
+        name="dma"
+    else
+        name="tlm"
+    fi
+    eval "w=\${$((masters + 1))}"
+    printf "%-5s %10u %10u\n" $name $(($1)) $((w))
+    shift
+    m=$((m + 1))
+done
+eval "clocks=\${$((masters + 1))}"
+printf "%u clocks\n" $((clocks))
@@ -0,0 +1,261 @@
+/* SPDX-License-Identifier: [MIT] */
+
+/*
+ * Lookup table generator for servo/PWM scaling. Builds a 256 entry
+ * transfer curve per output channel from a config file and writes them
+ * out as C, see lut_map() in sw/rsio.h.
+ *
+ *   lutgen servopwmscale.lut servopwmscale_lut
+ *
+ * writes servopwmscale_lut.c with the tables and servopwmscale_lut.h with
+ * their declarations, each table is named lut_<name>.
+ *
+ * Config file, one channel per line, '#' starts a comment:
+ *
+ *   name  center  deadband  gain    expo  lo  hi   mode
+ *   fwd   128     4         2.5625  0     0   255  +
+ *
+ * center   input value at the stick center
+ * deadband inputs closer than this to the center give no output
+ * gain     output per input step away from the center
+ * expo     0 - 1, blends the linear response with a cubic one, softer
+ *          around the center and the same at the ends
+ * lo, hi   clamp for the scaled output
+ * mode     +  magnitude above the center, 0 below it
+ *          -  magnitude below the center, 0 above it
+ *          s  servo, 128 +/- the scaled offset
+ *          r  reversed servo, 128 -/+ the scaled offset
+ *
+ * The scaled value is rounded down, so expo 0 matches integer multiply
+ * and shift code with the same gain.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+
+#define LUT_MAX     16
+#define LUT_RANGE   128.0   /* largest input step from the center */
+
+typedef struct {
+    char        name[32];
+    int         center;
+    int         deadband;
+    double      gain;
+    double      expo;
+    int         lo;
+    int         hi;
+    char        mode;
+    uint8_t     v[256];
+} lut_t;
+
+static void
+lut_build(lut_t *l)
+{
+    int n;
+
+    for (n = 0; n < 256; n++) {
+        int x = n - l->center;
+        int m, out;
+        double y;
+
+        switch (l->mode) {
+        case '+': m = x; break;
+        case '-': m = -x; break;
+        default:  m = abs(x); break;
+        }
+
+        if (m < l->deadband || m <= 0) {
+            l->v[n] = (l->mode == 's' || l->mode == 'r') ? 128 : 0;
+            continue;
+        }
+
+        y = (1.0 - l->expo) * m +
+            l->expo * m * m * m / (LUT_RANGE * LUT_RANGE);
+        out = (int)floor(y * l->gain);
+
+        if (l->mode == 's')
+            out = 128 + (x < 0 ? -out : out);
+        else if (l->mode == 'r')
+            out = 128 + (x < 0 ? out : -out);
+
+        if (out < l->lo)
+            out = l->lo;
+        if (out > l->hi)
+            out = l->hi;
+        l->v[n] = out;
+    }
+}
+
+static int
+lut_parse(const char *conf, lut_t *luts)
+{
+    char line[256];
+    int nluts = 0;
+    int lineno = 0;
+
+    FILE *fp = fopen(conf, "r");
+    if (fp == NULL) {
+        fprintf(stderr, "unable to open file: %s\n", conf);
+        return -1;
+    }
+
+    while (fgets(line, sizeof(line), fp)) {
+        lut_t *l = &luts[nluts];
+        char mode[4];
+        char *p;
+        int k;
+
+        lineno++;
+        if ((p = strchr(line, '#')))
+            *p = '\0';
+        for (p = line; isspace((unsigned char)*p); p++)
+            ;
+        if (!*p)
+            continue;
+
+        if (nluts == LUT_MAX) {
+            fprintf(stderr, "%s:%d: more than %d tables\n", conf, lineno,
+                LUT_MAX);
+            goto err;
+        }
+
+        memset(l, 0, sizeof(*l));
+        if (sscanf(p, "%31s %d %d %lf %lf %d %d %3s", l->name, &l->center,
+                &l->deadband, &l->gain, &l->expo, &l->lo, &l->hi, mode) != 8) {
+            fprintf(stderr, "%s:%d: expected name center deadband gain "
+                "expo lo hi mode\n", conf, lineno);
+            goto err;
+        }
+        l->mode = mode[0];
+
+        for (k = 0; l->name[k]; k++) {
+            if (!isalnum((unsigned char)l->name[k]) && l->name[k] != '_') {
+                fprintf(stderr, "%s:%d: name must be a C identifier\n", conf,
+                    lineno);
+                goto err;
+            }
+        }
+        if (l->center < 0 || l->center > 255 || l->deadband < 0 ||
+                l->expo < 0.0 || l->expo > 1.0 || l->lo < 0 || l->hi > 255 ||
+                l->lo > l->hi || !strchr("+-sr", l->mode) || mode[1]) {
+            fprintf(stderr, "%s:%d: value out of range\n", conf, lineno);
+            goto err;
+        }
+        for (k = 0; k < nluts; k++) {
+            if (!strcmp(luts[k].name, l->name)) {
+                fprintf(stderr, "%s:%d: duplicate name %s\n", conf, lineno,
+                    l->name);
+                goto err;
+            }
+        }
+
+        lut_build(l);
+        nluts++;
+    }
+
+    fclose(fp);
+    return nluts;
+
+err:
+    fclose(fp);
+    return -1;
+}
+
+static int
+write_header(const char *path, const char *conf, const char *guard,
+    lut_t *luts, int nluts)
+{
+    int n;
+
+    FILE *fp = fopen(path, "w");
+    if (fp == NULL) {
+        fprintf(stderr, "unable to create file: %s\n", path);
+        return 1;
+    }
+
+    fprintf(fp, "/* Generated by lutgen from %s, do not edit */\n\n", conf);
+    fprintf(fp, "#ifndef %s\n#define %s\n\n", guard, guard);
+    fprintf(fp, "#include \"rsio.h\"\n\n");
+    for (n = 0; n < nluts; n++)
+        fprintf(fp, "extern const rsio_lut_t lut_%s;\n", luts[n].name);
+    fprintf(fp, "\n#endif\n");
+
+    return fclose(fp) ? 1 : 0;
+}
+
+static int
+write_source(const char *path, const char *conf, const char *header,
+    lut_t *luts, int nluts)
+{
+    int n, k;
+
+    FILE *fp = fopen(path, "w");
+    if (fp == NULL) {
+        fprintf(stderr, "unable to create file: %s\n", path);
+        return 1;
+    }
+
+    fprintf(fp, "/* Generated by lutgen from %s, do not edit */\n\n", conf);
+    fprintf(fp, "#include \"%s\"\n", header);
+    for (n = 0; n < nluts; n++) {
+        lut_t *l = &luts[n];
+
+        fprintf(fp, "\n/* center %d, deadband %d, gain %g, expo %g, "
+            "clamp %d-%d, mode %c */\n", l->center, l->deadband, l->gain,
+            l->expo, l->lo, l->hi, l->mode);
+        fprintf(fp, "const rsio_lut_t lut_%s RSIO_LUT = {{", l->name);
+        for (k = 0; k < 256; k++)
+            fprintf(fp, "%s0x%02x,", (k % 16) ? " " : "\n    ", l->v[k]);
+        fprintf(fp, "\n}};\n");
+    }
+
+    return fclose(fp) ? 1 : 0;
+}
+
+int
+main(int argc, char *argv[])
+{
+    static lut_t luts[LUT_MAX];
+    char cpath[256], hpath[256], guard[256];
+    const char *base;
+    int nluts, n;
+
+    if (argc < 3) {
+        fprintf(stderr, "usage: lutgen <config> <output basename>\n");
+        return 1;
+    }
+
+    if (snprintf(cpath, sizeof(cpath), "%s.c", argv[2]) >= sizeof(cpath) ||
+            snprintf(hpath, sizeof(hpath), "%s.h", argv[2]) >= sizeof(hpath)) {
+        fprintf(stderr, "output name too long\n");
+        return 1;
+    }
+
+    /* Include guard and #include from the file name, without directories */
+    base = strrchr(argv[2], '/') ? strrchr(argv[2], '/') + 1 : argv[2];
+    for (n = 0; base[n] && n < sizeof(guard) - 3; n++)
+        guard[n] = isalnum((unsigned char)base[n]) ?
+            toupper((unsigned char)base[n]) : '_';
+    strcpy(&guard[n], "_H");
+
+    nluts = lut_parse(argv[1], luts);
+    if (nluts < 0)
+        return 1;
+    if (nluts == 0) {
+        fprintf(stderr, "%s: no tables\n", argv[1]);
+        return 1;
+    }
+
+    if (write_header(hpath, argv[1], guard, luts, nluts))
+        return 1;
+    if (write_source(cpath, argv[1], strrchr(hpath, '/') ?
+            strrchr(hpath, '/') + 1 : hpath, luts, nluts))
+        return 1;
+
+    fprintf(stderr, "%d tables\n", nluts);
+    return 0;
+}
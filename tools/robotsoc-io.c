@@ -9,7 +9,13 @@
 #include <getopt.h>
 #include <fcntl.h>
 #include <byteswap.h>
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
 #include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
 #include <linux/types.h>
 #include <linux/spi/spidev.h>
 
@@ -37,6 +43,38 @@
 #define BRAM_SIZE   18432
 #define BRAM_DEPTH (BRAM_SIZE / 4)
 
+/* External SRAM, adr[23:22] == 2'b10 */
+#define SRAM_ADDR   0x800000
+#define SRAM_SIZE   131072
+#define SRAM_DEPTH (SRAM_SIZE / 4)
+
+/* SRAM cache control, see source/wb_sramcache.v */
+#define SRAM_CACHE_CTL          0xC70000
+#define SRAM_CACHE_INVALIDATE   0x1
+#define SRAM_CACHE_CLEAR        0x2
+
+/* Image buffers hold the larger of the two memories */
+#define MEM_DEPTH   SRAM_DEPTH
+
+/* Size in bytes of the memory an image at 'addr' goes to */
+#define MEM_SIZE(addr) \
+    ((((addr) & 0xC00000) == SRAM_ADDR) ? SRAM_SIZE : BRAM_SIZE)
+
+/*
+ * Default length of the benchmark scratch area, set with --scratch. No
+ * memory is reserved for the host, so the area has to be one the running
+ * program leaves alone.
+ */
+#define SCRATCH_LEN 2048
+
+/*
+ * Read turnaround, number of dummy bytes the FPGA gets to fetch the first
+ * word of a read. Zero uses the plain read command, which only works at
+ * low SPI clock rates. Set with --dummy.
+ */
+static int spi_dummy = 0;
+
+
 int
 spi_read(int fd, uint32_t addr, uint32_t *data)
 {
@@ -45,17 +83,20 @@ spi_read(int fd, uint32_t addr, uint32_t *data)
         return -1;
     }
 
-    uint32_t cmd = 0x10000000 | (addr & 0xFFFFFF);
+    uint32_t cmd[5] = { 0 };
     uint32_t dat = 0;
 
+    cmd[0] = spi_dummy ? 0x20000000 | (spi_dummy << 24) : 0x10000000;
+    cmd[0] |= addr & 0xFFFFFF;
+
     /* Over the wire is big-endian */
-    cmd = bswap_32(cmd);
+    cmd[0] = bswap_32(cmd[0]);
 
     struct spi_ioc_transfer tr[] = {
             {
-            .tx_buf = (uintptr_t)&cmd,
+            .tx_buf = (uintptr_t)&cmd[0],
             .rx_buf = (uintptr_t)NULL,
-            .len = 4,
+            .len = 4 + spi_dummy,
         },
             {
             .tx_buf = (uintptr_t)NULL,
@@ -104,7 +145,14 @@ spi_write_be(int fd, uint32_t addr, uint32_t data, uint32_t bsel)
 
 }
 
+/*
+ * Block transfer chunk size in words, SBUF_LEN unless changed by the link
+ * benchmark. SBUF_MAX keeps a chunk within the default spidev bufsiz.
+ */
 #define SBUF_LEN 256
+#define SBUF_MAX 512
+
+static int sbuf_len = SBUF_LEN;
 
 /*
  * SPI write block of data, incoming data must be word aligned. Length is the
@@ -123,7 +171,7 @@ spi_write_block(int fd, uint32_t addr, uint32_t *data, int len)
      * data. Linux spidev places limits on the max size of a single transfer,
      * so send data over in chunks.
      */
-    uint32_t sbuf[SBUF_LEN];
+    uint32_t sbuf[SBUF_MAX];
     uint32_t bsel = 0xf;
 
     int k;
@@ -134,7 +182,7 @@ spi_write_block(int fd, uint32_t addr, uint32_t *data, int len)
         cmd = bswap_32(cmd);
 
         /* Number of words to copy in */
-        uint32_t nwords = (remaining > SBUF_LEN) ? SBUF_LEN : remaining;
+        uint32_t nwords = (remaining > sbuf_len) ? sbuf_len : remaining;
         uint32_t nbytes = nwords * 4;
 
         for (k = 0; k < nwords; k++)
@@ -185,25 +233,29 @@ spi_read_block(int fd, uint32_t addr, uint32_t *data, int len)
      * data. Linux spidev places limits on the max size of a single transfer,
      * so send data over in chunks.
      */
-    uint32_t sbuf[SBUF_LEN];
+    uint32_t sbuf[SBUF_MAX];
     uint32_t bsel = 0xf;
+    uint32_t op = spi_dummy ? 0x20000000 | (spi_dummy << 24)
+                    : 0x10000000 | (bsel << 24);
 
     int k;
     int i = 0;
     int remaining = len;
     while (remaining > 0) {
-        uint32_t cmd = 0x10000000 | (bsel << 24) | (addr & 0xFFFFFF); 
-        cmd = bswap_32(cmd);
+        uint32_t cmd[5] = { 0 };
+        cmd[0] = bswap_32(op | (addr & 0xFFFFFF));
 
-        /* Number of words to copy in */
-        uint32_t nwords = (remaining > SBUF_LEN) ? SBUF_LEN : remaining;
+        /* Number of words to copy in, registers are read one per command */
+        uint32_t nwords = (remaining > sbuf_len) ? sbuf_len : remaining;
+        if (addr & 0x400000)
+            nwords = 1;
         uint32_t nbytes = nwords * 4;
 
         struct spi_ioc_transfer tr[] = {
                 {
-                .tx_buf = (uintptr_t)&cmd,
+                .tx_buf = (uintptr_t)&cmd[0],
                 .rx_buf = (uintptr_t)NULL,
-                .len = 4,
+                .len = 4 + spi_dummy,
             },
                 {
                 .tx_buf = (uintptr_t)NULL,
@@ -227,6 +279,261 @@ spi_read_block(int fd, uint32_t addr, uint32_t *data, int len)
     return 0;
 }
 
+/*
+ * Batched transfers. Commands are queued up and sent to the FPGA using a
+ * single SPI_IOC_MESSAGE ioctl. Each command is a command word transfer
+ * followed by a data transfer. The data transfer of each command has
+ * cs_change set so chip select toggles between commands; that's how the
+ * FPGA SPI slave finds the start of the next command word.
+ *
+ * Linux spidev limits the total number of bytes in a single message
+ * (bufsiz module parameter, 4096 by default). Command words and data
+ * share one buffer so the limit is easy to track. Queue functions flush
+ * the batch when it fills up.
+ *
+ * If the file descriptor is a socket connected to a robotsoc-io daemon the
+ * queued commands are sent to the daemon instead, see run_daemon().
+ */
+#define BATCH_XFERS 128
+#define BATCH_WORDS 1024
+
+typedef struct {
+    int fd;
+    int remote; /* fd is a daemon socket, not spidev */
+    int dummy;  /* read turnaround bytes, the daemon handles it for clients */
+    int ntr;    /* number of queued transfers, two per command */
+    int nwords; /* number of words used in buf */
+    int err;    /* set by a failed flush, cleared by the owner */
+    struct spi_ioc_transfer tr[BATCH_XFERS];
+    uint32_t buf[BATCH_WORDS];      /* big endian, over the wire format */
+    uint32_t *rd_dst[BATCH_XFERS];  /* read destination, per transfer */
+} spi_batch_t;
+
+void
+spi_batch_init(spi_batch_t *b, int fd)
+{
+    struct stat st;
+    memset(b, 0, sizeof(*b));
+    b->fd = fd;
+    b->remote = !fstat(fd, &st) && S_ISSOCK(st.st_mode);
+    b->dummy = b->remote ? 0 : spi_dummy;
+}
+
+/* Daemon request & response headers, host byte order */
+typedef struct {
+    uint32_t cmd;   /* same format as the SPI command word */
+    uint32_t len;   /* number of data words */
+} rio_req_t;
+
+typedef struct {
+    int32_t  rc;
+    uint32_t len;   /* number of data words, reads only */
+} rio_rsp_t;
+
+static int
+xfer_all(int fd, void *buf, int len, int wr)
+{
+    char *p = buf;
+    while (len > 0) {
+        int rc = wr ? write(fd, p, len) : read(fd, p, len);
+        if (rc <= 0) {
+            if (rc < 0 && errno == EINTR)
+                continue;
+            return -1;
+        }
+        p += rc;
+        len -= rc;
+    }
+    return 0;
+}
+
+/*
+ * Send queued commands to the daemon. All requests are written before any
+ * response is read so the daemon can merge them into a single ioctl.
+ */
+static int
+spi_batch_flush_remote(spi_batch_t *b)
+{
+    int n, k, rc = 0;
+    for (n = 0; !rc && n < b->ntr; n += 2) {
+        uint32_t *c = (uint32_t*)(uintptr_t)b->tr[n].tx_buf;
+        uint32_t *d = (uint32_t*)(uintptr_t)b->tr[n + 1].tx_buf;
+        rio_req_t req = { bswap_32(*c), b->tr[n + 1].len / 4 };
+        rc = xfer_all(b->fd, &req, sizeof(req), 1);
+        if (rc || !d)
+            continue;
+        for (k = 0; k < req.len; k++)
+            d[k] = bswap_32(d[k]);
+        rc = xfer_all(b->fd, d, req.len * 4, 1);
+    }
+
+    for (n = 0; !rc && n < b->ntr; n += 2) {
+        rio_rsp_t rsp;
+        rc = xfer_all(b->fd, &rsp, sizeof(rsp), 0);
+        if (!rc && rsp.len)
+            rc = xfer_all(b->fd, b->rd_dst[n + 1], rsp.len * 4, 0);
+        if (!rc)
+            rc = rsp.rc;
+    }
+
+    return rc;
+}
+
+int
+spi_batch_flush(spi_batch_t *b)
+{
+    int rc, n, k;
+    if (b->ntr == 0)
+        return 0;
+
+    if (b->remote) {
+        rc = spi_batch_flush_remote(b);
+    } else {
+        /* cs_change on the last transfer means keep chip select asserted */
+        b->tr[b->ntr - 1].cs_change = 0;
+        rc = ioctl(b->fd, SPI_IOC_MESSAGE(b->ntr), b->tr) < 1 ? -1 : 0;
+
+        /* Copy out read data, host byte order */
+        for (n = 0; n < b->ntr; n++) {
+            if (!b->rd_dst[n])
+                continue;
+            uint32_t *src = (uint32_t*)(uintptr_t)b->tr[n].rx_buf;
+            for (k = 0; k < b->tr[n].len / 4; k++)
+                b->rd_dst[n][k] = bswap_32(src[k]);
+        }
+    }
+
+    if (rc)
+        b->err = rc;
+    b->ntr = 0;
+    b->nwords = 0;
+    memset(b->tr, 0, sizeof(b->tr));
+    memset(b->rd_dst, 0, sizeof(b->rd_dst));
+    return rc;
+}
+
+/*
+ * Queue a single command. Returns a pointer to the data words for this
+ * command, which may be up to 'len' words long. The returned length is
+ * limited by the space left in the batch. 'pad' zero bytes are sent after
+ * the command word, these are the read turnaround bytes.
+ */
+static uint32_t *
+spi_batch_cmd(spi_batch_t *b, uint32_t cmd, int pad, int *len)
+{
+    int rc;
+    int pw = (pad + 3) / 4;
+    if ((b->ntr + 2 > BATCH_XFERS) || (b->nwords + pw + 2 > BATCH_WORDS)) {
+        rc = spi_batch_flush(b);
+        if (rc)
+            return NULL;
+    }
+
+    int room = BATCH_WORDS - b->nwords - pw - 1;
+    if (*len > room)
+        *len = room;
+
+    uint32_t *c = &b->buf[b->nwords];
+    uint32_t *d = &b->buf[b->nwords + 1 + pw];
+    *c = bswap_32(cmd);
+    memset(c + 1, 0, pw * 4);
+
+    b->tr[b->ntr].tx_buf = (uintptr_t)c;
+    b->tr[b->ntr].len = 4 + pad;
+    b->tr[b->ntr + 1].len = *len * 4;
+    b->tr[b->ntr + 1].cs_change = 1;
+
+    b->nwords += 1 + pw + *len;
+    b->ntr += 2;
+    return d;
+}
+
+/* Queue a read of 'len' words, data is valid after the batch is flushed */
+int
+spi_batch_read(spi_batch_t *b, uint32_t addr, uint32_t *data, int len)
+{
+    if ((addr & 0x3) || (addr & 0xFF000000)) {
+        return -1;
+    }
+
+    /*
+     * The FPGA reads ahead during bursts from memory. In register regions
+     * (address bit 22 set) it reads only the addressed word of a command,
+     * the rest of the burst reads 0xDEADDEAD, so read them one word per
+     * command.
+     */
+    uint32_t cmd = b->dummy ? 0x20000000 | (b->dummy << 24) : 0x1F000000;
+    while (len > 0) {
+        int n = (addr & 0x400000) ? 1 : len;
+        uint32_t *d = spi_batch_cmd(b, cmd | (addr & 0xFFFFFF), b->dummy, &n);
+        if (!d)
+            return -1;
+
+        b->tr[b->ntr - 1].rx_buf = (uintptr_t)d;
+        b->rd_dst[b->ntr - 1] = data;
+
+        data += n;
+        addr += n * 4;
+        len  -= n;
+    }
+    return 0;
+}
+
+int
+spi_batch_write_block(spi_batch_t *b, uint32_t addr, const uint32_t *data,
+    int len)
+{
+    int k;
+    if ((addr & 0x3) || (addr & 0xFF000000)) {
+        return -1;
+    }
+
+    while (len > 0) {
+        int n = len;
+        uint32_t *d = spi_batch_cmd(b, 0x0F000000 | (addr & 0xFFFFFF), 0, &n);
+        if (!d)
+            return -1;
+
+        for (k = 0; k < n; k++)
+            d[k] = bswap_32(data[k]);
+        b->tr[b->ntr - 1].tx_buf = (uintptr_t)d;
+
+        data += n;
+        addr += n * 4;
+        len  -= n;
+    }
+    return 0;
+}
+
+int
+spi_batch_write_be(spi_batch_t *b, uint32_t addr, uint32_t data,
+    uint32_t bsel)
+{
+    int n = 1;
+    if ((addr & 0x3) || (addr & 0xFF000000)) {
+        return -1;
+    }
+
+    /* Invalid byte select */
+    if ((bsel & ~0xf) || (bsel == 0)) {
+        return -1;
+    }
+
+    uint32_t *d = spi_batch_cmd(b, (bsel << 24) | (addr & 0xFFFFFF), 0, &n);
+    if (!d)
+        return -1;
+
+    *d = bswap_32(data);
+    b->tr[b->ntr - 1].tx_buf = (uintptr_t)d;
+    return 0;
+}
+
+int
+spi_batch_write(spi_batch_t *b, uint32_t addr, uint32_t data)
+{
+    return spi_batch_write_be(b, addr, data, 0xF);
+}
+
 #if 0
 int spi_xfer(int fd, uint8_t *tx, uint8_t *rx, int len)
 {
@@ -245,11 +552,10 @@ int spi_xfer(int fd, uint8_t *tx, uint8_t *rx, int len)
  * clock polarity = 0, phase = 0
  */
 int
-spi_open(const char *device, uint32_t mode)
+spi_open(const char *device, uint32_t mode, uint32_t speed)
 {
     int ret = 0;
     uint8_t bits = 8;
-    uint32_t speed = 1000000;
     int fd = open(device, O_RDWR);
     const char *msg = NULL;
     do {
@@ -319,6 +625,1027 @@ spi_open(const char *device, uint32_t mode)
 }
 
 
+/* Write only register, SPI master only. Bit N holds CPU N in reset */
+#define CPU_RESET_ADDR 0x100000
+
+/*
+ * Read a binary image file into a 'size' bytes buffer. The part of the
+ * buffer not covered by the file is zero filled. Returns number of bytes
+ * read from the file, or -1 on error. This assumes a LE host CPU.
+ */
+int
+read_image(const char *rom, uint32_t *dmem, int size)
+{
+    int rc;
+    int n = 0;
+    FILE *fp = fopen(rom, "r");
+    if (!fp) {
+        printf("Unable to open ROM file: %s\n", rom);
+        return -1;
+    }
+
+    memset(dmem, 0, size);
+    while (n < size) {
+        int rem = size - n;
+        char *ptr = &((char*)dmem)[n];
+        rc = fread(ptr, 1, rem, fp);
+        if (rc < 0)
+            break;
+
+        /* read some data, keep track */
+        n += rc;
+        if (rc < rem)
+            break;
+    }
+    fclose(fp);
+    return n;
+}
+
+/*
+ * CRC32 engine registers, see wb_crc.v. The engine reads memory as a bus
+ * master and computes the same CRC32 as zlib, so image verification costs
+ * a few register accesses instead of reading back the whole image.
+ */
+#define CRC_ADR     0xC00000
+#define CRC_LEN     0xC00004
+#define CRC_CTL     0xC00008
+#define CRC_VAL     0xC0000C
+
+/* Image verification modes */
+#define VERIFY_READBACK 0
+#define VERIFY_CRC      1
+
+/* IEEE 802.3 CRC32, zlib compatible */
+uint32_t
+crc32(uint32_t crc, const void *buf, int len)
+{
+    const uint8_t *p = buf;
+    int k;
+    crc = ~crc;
+    while (len--) {
+        crc ^= *p++;
+        for (k = 0; k < 8; k++)
+            crc = (crc >> 1) ^ ((crc & 1) ? 0xEDB88320 : 0);
+    }
+    return ~crc;
+}
+
+/*
+ * Compute the CRC32 of 'len' words of memory on the FPGA. The engine takes
+ * about 35 system clocks per word, poll until it's done.
+ */
+int
+batch_crc(spi_batch_t *b, uint32_t addr, int len, uint32_t *crc)
+{
+    uint32_t sts[2];
+    int rc, n;
+
+    rc  = spi_batch_write(b, CRC_ADR, addr);
+    rc |= spi_batch_write(b, CRC_LEN, len);
+    rc |= spi_batch_write(b, CRC_CTL, 1);
+    for (n = 0; !rc && n < 1000; n++) {
+        rc |= spi_batch_read(b, CRC_CTL, sts, 2);
+        rc |= spi_batch_flush(b);
+        if (!(sts[0] & 1)) {
+            *crc = sts[1];
+            return rc;
+        }
+        usleep(1000);
+    }
+    return -1;
+}
+
+/* Compare memory against an image using the CRC32 engine */
+int
+batch_crc_verify(spi_batch_t *b, uint32_t addr, uint32_t *dmem, int len)
+{
+    uint32_t crc = 0;
+    uint32_t exp = crc32(0, dmem, len * 4);
+    int rc = batch_crc(b, addr, len, &crc);
+    if (rc) {
+        printf("crc engine error\n");
+        return rc;
+    }
+    if (crc != exp) {
+        printf("mem crc mismatch: 0x%08x, expected 0x%08x\n", crc, exp);
+        return 1;
+    }
+    return 0;
+}
+
+/*
+ * Start the SRAM cache over after loading new code into the SRAM. Loader
+ * writes already update cached lines, this leaves a cold cache and zeroed
+ * hit/miss counters for the new program.
+ */
+static int
+batch_sram_cache_reset(spi_batch_t *b, uint32_t addr)
+{
+    if ((addr & 0xC00000) != SRAM_ADDR)
+        return 0;
+    return spi_batch_write(b, SRAM_CACHE_CTL,
+        SRAM_CACHE_INVALIDATE | SRAM_CACHE_CLEAR);
+}
+
+/* Load a ROM image into BRAM or SRAM and verify it */
+int
+batch_load(spi_batch_t *b, uint32_t addr, const char *rom, int verify,
+    int verbose)
+{
+    static uint32_t dmem[MEM_DEPTH];
+    static uint32_t rmem[MEM_DEPTH]; // used for read back / data compare
+    int depth = MEM_SIZE(addr) / 4;
+    int rc, n;
+
+    printf("Loading mem file: %s\n", rom);
+    n = read_image(rom, dmem, depth * 4);
+    if (n < 0)
+        return 1;
+    printf("mem file, read %d bytes\n", n);
+
+    /* Always write the whole mem array */
+    rc  = spi_batch_write_block(b, addr, dmem, depth);
+    rc |= batch_sram_cache_reset(b, addr);
+    if (rc) {
+        printf("mem write error\n");
+        return rc;
+    }
+
+    if (verify == VERIFY_CRC)
+        return batch_crc_verify(b, addr, dmem, depth);
+
+    rc  = spi_batch_read(b, addr, rmem, depth);
+    rc |= spi_batch_flush(b);
+    if (rc) {
+        printf("mem read error\n");
+        return rc;
+    }
+
+    for (n = 0; n < depth; n++) {
+        if (rmem[n] != dmem[n]) {
+            printf("mem compare mismatch at addr: 0x%x\n", addr + n);
+            return 1;
+        }
+        if (verbose)
+            printf("0x%04X: 0x%08X\n", n, rmem[n]);
+    }
+    return 0;
+}
+
+/*
+ * Delta load. Reads back the current memory contents, then writes only the
+ * word runs that differ from the image. Only the words that were written
+ * get read back for verification; the rest already matched. Runs separated
+ * by a single matching word are merged since a new command costs as much
+ * as rewriting that word. The CPUs must be held in reset, otherwise the
+ * running program may change memory between the read back and the write.
+ *
+ * With CRC verification the read back is skipped entirely if memory already
+ * holds the image, and the written runs are verified with a single CRC of
+ * the whole image.
+ */
+#define DELTA_GAP 1
+
+int
+batch_load_delta(spi_batch_t *b, uint32_t addr, const char *rom, int verify,
+    int verbose)
+{
+    static uint32_t dmem[MEM_DEPTH];
+    static uint32_t rmem[MEM_DEPTH];
+    static uint32_t vmem[MEM_DEPTH];
+    int depth = MEM_SIZE(addr) / 4;
+    int rc, n, k;
+    int nruns = 0;
+    int nwords = 0;
+
+    printf("Loading mem file: %s\n", rom);
+    n = read_image(rom, dmem, depth * 4);
+    if (n < 0)
+        return 1;
+    printf("mem file, read %d bytes\n", n);
+
+    if (verify == VERIFY_CRC) {
+        uint32_t crc = 0;
+        rc = batch_crc(b, addr, depth, &crc);
+        if (!rc && crc == crc32(0, dmem, depth * 4)) {
+            printf("delta: wrote 0 words in 0 runs\n");
+            return 0;
+        }
+    }
+
+    rc  = spi_batch_read(b, addr, rmem, depth);
+    rc |= spi_batch_flush(b);
+    if (rc) {
+        printf("mem read error\n");
+        return rc;
+    }
+
+    /*
+     * Write and read back each run of changed words. Words that don't get
+     * written already match, the verify buffer starts out as the image.
+     */
+    memcpy(vmem, dmem, depth * 4);
+    for (n = 0; n < depth; ) {
+        if (rmem[n] == dmem[n]) {
+            n++;
+            continue;
+        }
+
+        /* Find the end of this run, merging across small gaps */
+        int end = n + 1;
+        for (k = end; k < depth && k <= end + DELTA_GAP; k++)
+            if (rmem[k] != dmem[k])
+                end = k + 1;
+
+        rc |= spi_batch_write_block(b, addr + n * 4, &dmem[n], end - n);
+        if (verify != VERIFY_CRC) {
+            for (k = n; k < end; k++)
+                vmem[k] = ~dmem[k];
+            rc |= spi_batch_read(b, addr + n * 4, &vmem[n], end - n);
+        }
+        if (verbose)
+            printf("delta: 0x%04X-0x%04X\n", n * 4, end * 4 - 1);
+
+        nwords += end - n;
+        nruns++;
+        n = end;
+    }
+
+    if (nwords)
+        rc |= batch_sram_cache_reset(b, addr);
+    rc |= spi_batch_flush(b);
+    if (rc) {
+        printf("mem write error\n");
+        return rc;
+    }
+
+    if (verify == VERIFY_CRC && nwords) {
+        rc = batch_crc_verify(b, addr, dmem, depth);
+        if (rc)
+            return rc;
+    }
+
+    for (n = 0; n < depth; n++) {
+        if (vmem[n] != dmem[n]) {
+            printf("mem compare mismatch at addr: 0x%x\n", addr + n);
+            return 1;
+        }
+    }
+
+    printf("delta: wrote %d words in %d runs\n", nwords, nruns);
+    return 0;
+}
+
+/* Dump BRAM or SRAM to a file */
+int
+batch_dump(spi_batch_t *b, uint32_t addr, const char *rdf)
+{
+    static uint32_t rmem[MEM_DEPTH];
+    int depth = MEM_SIZE(addr) / 4;
+    int rc;
+
+    printf("Dumping %s to: %s\n", depth == BRAM_DEPTH ? "BRAM" : "SRAM", rdf);
+    rc  = spi_batch_read(b, addr, rmem, depth);
+    rc |= spi_batch_flush(b);
+    if (rc) {
+        printf("mem read error\n");
+        return rc;
+    }
+
+    FILE *fp = fopen(rdf, "w+");
+    if (!fp) {
+        printf("Unable to open ROM dump file: %s\n", rdf);
+        return 1;
+    }
+
+    rc = fwrite(rmem, 1, depth * 4, fp);
+    fclose(fp);
+    if (rc != depth * 4) {
+        printf("Unable to write ROM dump file\n");
+        return 1;
+    }
+    return 0;
+}
+
+/*
+ * Script / batch mode. Reads one command per line, blank lines and text
+ * following '#' are ignored. Commands are queued into as few SPI messages
+ * as possible. Read results are printed when the batch gets flushed. Image
+ * loads are verified using the 'verify' mode.
+ *
+ *   read  <addr> [count]        read one or more words
+ *   write <addr> <data> [bsel]  write a word, byte select 0xF if omitted
+ *   reset <mask>                write CPU reset register, bit N == CPU N
+ *   load  <file> [addr]         load and verify a ROM image
+ *   delta <file> [addr]         load a ROM image, writing changed words only
+ *   dump  <file> [addr]         dump BRAM, or SRAM at 0x800000, to a file
+ *   sleep <ms>                  flush pending commands, then wait
+ */
+#define SCRIPT_READS 1024
+
+int
+run_script(int fd, FILE *in, int verify, int verbose)
+{
+    static spi_batch_t b;
+    static uint32_t rdat[SCRIPT_READS];
+    static uint32_t radr[SCRIPT_READS];
+    char line[512];
+    int lineno = 0;
+    int nrd = 0;
+    int rc = 0;
+    int n;
+
+    spi_batch_init(&b, fd);
+
+    while (!rc && fgets(line, sizeof(line), in)) {
+        char *argv[4] = { NULL };
+        char *tok, *save = NULL;
+        int argc = 0;
+
+        lineno++;
+        if ((tok = strchr(line, '#')))
+            *tok = '\0';
+        for (tok = strtok_r(line, " \t\r\n", &save); tok && argc < 4;
+                tok = strtok_r(NULL, " \t\r\n", &save))
+            argv[argc++] = tok;
+        if (!argc)
+            continue;
+
+        uint32_t a1 = argc > 1 ? (uint32_t)strtoull(argv[1], NULL, 0) : 0;
+        uint32_t a2 = argc > 2 ? (uint32_t)strtoull(argv[2], NULL, 0) : 0;
+        uint32_t a3 = argc > 3 ? (uint32_t)strtoull(argv[3], NULL, 0) : 0xF;
+
+        /* Flush if the read result buffer can't hold another read */
+        int cnt = (!strcmp(argv[0], "read") && argc > 2) ? a2 : 1;
+        if (cnt < 1 || cnt > SCRIPT_READS) {
+            printf("line %d: invalid read count\n", lineno);
+            rc = 1;
+            break;
+        }
+        if (nrd + cnt > SCRIPT_READS || !strcmp(argv[0], "sleep")
+                || !strcmp(argv[0], "load") || !strcmp(argv[0], "dump")
+                || !strcmp(argv[0], "delta")) {
+            rc = spi_batch_flush(&b);
+            for (n = 0; n < nrd; n++)
+                printf(" read: 0x%x=0x%08x\n", radr[n], rdat[n]);
+            nrd = 0;
+            if (rc)
+                break;
+        }
+
+        if (!strcmp(argv[0], "read") && argc >= 2) {
+            for (n = 0; n < cnt; n++)
+                radr[nrd + n] = a1 + n * 4;
+            rc = spi_batch_read(&b, a1, &rdat[nrd], cnt);
+            nrd += cnt;
+
+        } else if (!strcmp(argv[0], "write") && argc >= 3) {
+            rc = spi_batch_write_be(&b, a1, a2, a3);
+            if (verbose)
+                printf("write: 0x%x=0x%08x\n", a1, a2);
+
+        } else if (!strcmp(argv[0], "reset") && argc >= 2) {
+            rc = spi_batch_write(&b, CPU_RESET_ADDR, a1);
+
+        } else if (!strcmp(argv[0], "sleep") && argc >= 2) {
+            usleep(a1 * 1000);
+
+        } else if (!strcmp(argv[0], "load") && argc >= 2) {
+            rc = batch_load(&b, argc > 2 ? a2 : 0, argv[1], verify, verbose);
+
+        } else if (!strcmp(argv[0], "delta") && argc >= 2) {
+            rc = batch_load_delta(&b, argc > 2 ? a2 : 0, argv[1], verify,
+                    verbose);
+
+        } else if (!strcmp(argv[0], "dump") && argc >= 2) {
+            rc = batch_dump(&b, argc > 2 ? a2 : 0, argv[1]);
+
+        } else {
+            printf("line %d: invalid command: %s\n", lineno, argv[0]);
+            rc = 1;
+        }
+
+        if (rc < 0)
+            printf("line %d: transfer error!\n", lineno);
+    }
+
+    if (!rc) {
+        rc = spi_batch_flush(&b);
+        for (n = 0; n < nrd; n++)
+            printf(" read: 0x%x=0x%08x\n", radr[n], rdat[n]);
+    }
+
+    return rc;
+}
+
+/*
+ * Daemon mode. The daemon owns the spidev file descriptor and serves any
+ * number of clients (up to DAEMON_CLIENTS) over a UNIX stream socket.
+ *
+ * A client sends a stream of requests. Each request is a rio_req_t header
+ * followed by 'len' data words on a write. Every request gets a rio_rsp_t
+ * response, followed by 'len' data words on a read. Requests may be
+ * pipelined, responses come back in request order. Requests from all
+ * clients that arrive in the same poll round are merged into one batch,
+ * which normally goes out as a single SPI_IOC_MESSAGE ioctl.
+ *
+ * Each response has the status of its own request. A request with a bad
+ * address or byte select fails on its own and nothing of it is sent. A
+ * failed ioctl fails every request of that round, they shared it. A
+ * malformed request header closes the client before any of its pending
+ * requests are queued, the stream can't be followed past it.
+ *
+ * Request latency is measured from the time the request is received to
+ * the time the response is ready. It's reported when a client disconnects,
+ * and every DAEMON_REPORT seconds in verbose mode.
+ */
+#define DAEMON_CLIENTS  16
+#define DAEMON_BUF      (64 * 1024)
+#define DAEMON_REPORT   10
+
+typedef struct {
+    int fd;
+    int id;
+    int rx_len;         /* bytes in rx */
+    int tx_len;         /* bytes in tx */
+    int tx_off;         /* bytes of tx already sent */
+    uint64_t t_rx;      /* time of last receive, uS */
+    uint64_t nreq;      /* latency statistics */
+    uint64_t lat_sum;
+    uint64_t lat_max;
+    uint32_t rx[DAEMON_BUF / 4];
+    uint32_t tx[DAEMON_BUF / 4];
+} rio_client_t;
+
+static uint64_t
+now_us()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void
+client_report(rio_client_t *c, const char *why)
+{
+    printf("client %d %s: %llu requests, latency avg %llu uS, max %llu uS\n",
+        c->id, why, (unsigned long long)c->nreq,
+        (unsigned long long)(c->nreq ? c->lat_sum / c->nreq : 0),
+        (unsigned long long)c->lat_max);
+    fflush(stdout);
+}
+
+/*
+ * Queue all complete requests in the client receive buffer. Stops early if
+ * the transmit buffer doesn't have room for the response. Returns -1 on a
+ * malformed request, in which case nothing is queued. The queue functions
+ * check the address and byte select before queueing anything, so their
+ * return code is the request's own status.
+ */
+static int
+client_queue(spi_batch_t *b, rio_client_t *c)
+{
+    int off = 0;
+    char *rx = (char*)c->rx;
+
+    /* Check every request header received so far first */
+    while (off + (int)sizeof(rio_req_t) <= c->rx_len) {
+        rio_req_t *req = (rio_req_t*)&rx[off];
+        uint32_t op = req->cmd >> 28;
+
+        if ((op > 1) || !req->len
+                || (req->len > (DAEMON_BUF - sizeof(rio_rsp_t)) / 8))
+            return -1;
+
+        off += sizeof(rio_req_t) + ((op == 0) ? req->len * 4 : 0);
+    }
+
+    off = 0;
+    while (c->rx_len - off >= sizeof(rio_req_t)) {
+        rio_req_t *req = (rio_req_t*)&rx[off];
+        uint32_t op   = req->cmd >> 28;
+        uint32_t bsel = (req->cmd >> 24) & 0xF;
+        uint32_t addr = req->cmd & 0xFFFFFF;
+        int rdlen = (op == 1) ? req->len * 4 : 0;
+        int wrlen = (op == 0) ? req->len * 4 : 0;
+
+        if (c->rx_len - off < sizeof(rio_req_t) + wrlen)
+            break;
+        if (c->tx_len + sizeof(rio_rsp_t) + rdlen > DAEMON_BUF)
+            break;
+
+        rio_rsp_t *rsp = (rio_rsp_t*)&((char*)c->tx)[c->tx_len];
+        uint32_t *dat = (uint32_t*)&rsp[1];
+        uint32_t *wdat = (uint32_t*)&req[1];
+        rsp->len = rdlen / 4;
+
+        if (op == 1)
+            rsp->rc = spi_batch_read(b, addr, dat, req->len);
+        else if (req->len == 1)
+            rsp->rc = spi_batch_write_be(b, addr, wdat[0], bsel);
+        else
+            rsp->rc = spi_batch_write_block(b, addr, wdat, req->len);
+
+        c->tx_len += sizeof(rio_rsp_t) + rdlen;
+        off += sizeof(rio_req_t) + wrlen;
+    }
+
+    memmove(rx, &rx[off], c->rx_len - off);
+    c->rx_len -= off;
+    return 0;
+}
+
+/*
+ * Fill in latency for responses queued this round, and the transfer status
+ * for those that didn't already fail on their own.
+ */
+static void
+client_complete(rio_client_t *c, int start, int rc, uint64_t t)
+{
+    char *tx = (char*)c->tx;
+    while (start < c->tx_len) {
+        rio_rsp_t *rsp = (rio_rsp_t*)&tx[start];
+        uint64_t lat = t - c->t_rx;
+        if (!rsp->rc)
+            rsp->rc = rc;
+        c->nreq++;
+        c->lat_sum += lat;
+        c->lat_max = (lat > c->lat_max) ? lat : c->lat_max;
+        start += sizeof(rio_rsp_t) + rsp->len * 4;
+    }
+}
+
+int
+run_daemon(int fd, const char *path, int verbose)
+{
+    static spi_batch_t b;
+    static rio_client_t clients[DAEMON_CLIENTS];
+    struct pollfd pfd[DAEMON_CLIENTS + 1];
+    struct sockaddr_un sa = { .sun_family = AF_UNIX };
+    int start[DAEMON_CLIENTS];
+    int nclient = 0;
+    int nextid = 0;
+    int n, rc;
+    uint64_t t_report = now_us();
+
+    if (strlen(path) >= sizeof(sa.sun_path)) {
+        printf("socket path too long: %s\n", path);
+        return 1;
+    }
+    strcpy(sa.sun_path, path);
+    unlink(path);
+
+    int lfd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if ((lfd < 0) || bind(lfd, (struct sockaddr*)&sa, sizeof(sa))
+            || listen(lfd, DAEMON_CLIENTS)) {
+        printf("Unable to listen on socket: %s\n", path);
+        return 1;
+    }
+
+    /* Clients that go away with responses pending shouldn't kill us */
+    signal(SIGPIPE, SIG_IGN);
+    spi_batch_init(&b, fd);
+    printf("robotsoc-io daemon listening on %s\n", path);
+    fflush(stdout);
+
+    while (1) {
+        pfd[0].fd = lfd;
+        pfd[0].events = (nclient < DAEMON_CLIENTS) ? POLLIN : 0;
+        for (n = 0; n < nclient; n++) {
+            rio_client_t *c = &clients[n];
+            pfd[n + 1].fd = c->fd;
+            pfd[n + 1].events = (c->tx_len > c->tx_off) ? POLLOUT : 0;
+            if (c->rx_len < DAEMON_BUF)
+                pfd[n + 1].events |= POLLIN;
+        }
+
+        rc = poll(pfd, nclient + 1, verbose ? DAEMON_REPORT * 1000 : -1);
+        if (rc < 0 && errno != EINTR) {
+            printf("poll error\n");
+            return 1;
+        }
+        uint64_t t = now_us();
+
+        /* Receive & queue requests */
+        b.err = 0;
+        for (n = 0; n < nclient; n++) {
+            rio_client_t *c = &clients[n];
+            start[n] = c->tx_len;
+            if (pfd[n + 1].revents & (POLLIN | POLLHUP | POLLERR)) {
+                int len = read(c->fd, &((char*)c->rx)[c->rx_len],
+                            DAEMON_BUF - c->rx_len);
+                if (len <= 0) {
+                    client_report(c, "closed");
+                    close(c->fd);
+                    c->fd = -1;
+                    continue;
+                }
+                c->t_rx = t;
+                c->rx_len += len;
+            } else if (!c->rx_len) {
+                continue;
+            }
+
+            /* New requests, or ones stalled on a full transmit buffer */
+            if (client_queue(&b, c)) {
+                client_report(c, "bad request");
+                close(c->fd);
+                c->fd = -1;
+            }
+        }
+
+        /*
+         * One ioctl for everything queued above. Queueing may have flushed
+         * early when the batch filled up, b.err covers those flushes too.
+         */
+        spi_batch_flush(&b);
+        rc = b.err;
+        t = now_us();
+        for (n = 0; n < nclient; n++)
+            if (clients[n].fd >= 0)
+                client_complete(&clients[n], start[n], rc, t);
+
+        /* Send responses */
+        for (n = 0; n < nclient; n++) {
+            rio_client_t *c = &clients[n];
+            if (c->fd < 0 || c->tx_len == c->tx_off)
+                continue;
+            int len = write(c->fd, &((char*)c->tx)[c->tx_off],
+                        c->tx_len - c->tx_off);
+            if (len < 0 && errno != EAGAIN && errno != EINTR) {
+                client_report(c, "closed");
+                close(c->fd);
+                c->fd = -1;
+                continue;
+            }
+            c->tx_off += (len > 0) ? len : 0;
+            if (c->tx_off == c->tx_len)
+                c->tx_off = c->tx_len = 0;
+        }
+
+        /* Remove closed clients */
+        for (n = 0; n < nclient; ) {
+            if (clients[n].fd < 0)
+                clients[n] = clients[--nclient];
+            else
+                n++;
+        }
+
+        if (pfd[0].revents & POLLIN) {
+            int cfd = accept(lfd, NULL, NULL);
+            if (cfd >= 0) {
+                rio_client_t *c = &clients[nclient++];
+                memset(c, 0, sizeof(*c));
+                c->fd = cfd;
+                c->id = nextid++;
+                fcntl(cfd, F_SETFL, O_NONBLOCK);
+                if (verbose)
+                    printf("client %d connected\n", c->id);
+            }
+        }
+
+        if (verbose && (t - t_report >= DAEMON_REPORT * 1000000ULL)) {
+            for (n = 0; n < nclient; n++)
+                client_report(&clients[n], "running");
+            t_report = t;
+        }
+    }
+
+    return 0;
+}
+
+/* Connect to a robotsoc-io daemon */
+int
+rio_connect(const char *path)
+{
+    struct sockaddr_un sa = { .sun_family = AF_UNIX };
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    strncpy(sa.sun_path, path, sizeof(sa.sun_path) - 1);
+    if ((fd < 0) || connect(fd, (struct sockaddr*)&sa, sizeof(sa))) {
+        fprintf(stderr, "Unable to connect to daemon: %s\n", path);
+        if (fd >= 0)
+            close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/*
+ * Telemetry sampler, see source/wb_sampler.v. Each sample is gio rdt0-rdt6
+ * followed by the sample number. The sampler writes its ring into memory,
+ * the top of the SRAM unless SMP_BASE was moved.
+ */
+#define SMP_CTL     0xC10000
+#define SMP_PERIOD  0xC10004
+#define SMP_COUNT   0xC10008
+#define SMP_DEPTH   0xC1000C
+#define SMP_BASE    0xC10010
+#define SMP_WORDS   8
+#define SMP_MAX     256
+#define SYSCLK_HZ   50000000
+
+/*
+ * Log file header, little endian. The header is followed by one record of
+ * SMP_WORDS words per sample, as stored by the sampler. Gaps in the sample
+ * numbers are samples lost to ring overruns.
+ */
+typedef struct {
+    char     magic[4];  /* "RSTL" */
+    uint32_t version;
+    uint32_t words;     /* words per sample */
+    uint32_t rate;      /* samples per second */
+} tlm_hdr_t;
+
+static volatile sig_atomic_t tlm_stop;
+
+static void
+tlm_sigint(int sig)
+{
+    tlm_stop = 1;
+}
+
+/*
+ * Stream telemetry into a log file until interrupted. The ring is polled
+ * often enough to drain it at half full. A sample overwritten while it
+ * was being read shows up as a wrong sample number and gets dropped.
+ */
+int
+run_telemetry(int fd, const char *path, int rate, int verbose)
+{
+    static spi_batch_t b;
+    static uint32_t rec[SMP_MAX * SMP_WORDS];
+    tlm_hdr_t hdr = { { 'R', 'S', 'T', 'L' }, 1, SMP_WORDS, rate };
+    uint32_t depth = 0, count = 0, ring = 0, next;
+    uint64_t saved = 0, lost = 0;
+    int rc, k;
+
+    if (rate <= 0 || rate > SYSCLK_HZ / 8) {
+        printf("invalid sample rate: %d\n", rate);
+        return 1;
+    }
+
+    FILE *fp = strcmp(path, "-") ? fopen(path, "wb") : stdout;
+    if (!fp) {
+        printf("Unable to open log file: %s\n", path);
+        return 1;
+    }
+    fwrite(&hdr, sizeof(hdr), 1, fp);
+
+    spi_batch_init(&b, fd);
+    rc  = spi_batch_write(&b, SMP_CTL, 0x2);
+    rc |= spi_batch_write(&b, SMP_PERIOD, SYSCLK_HZ / rate);
+    rc |= spi_batch_write(&b, SMP_CTL, 0x1);
+    rc |= spi_batch_read(&b, SMP_DEPTH, &depth, 1);
+    rc |= spi_batch_read(&b, SMP_BASE, &ring, 1);
+    rc |= spi_batch_flush(&b);
+    if (rc || depth == 0 || depth > SMP_MAX) {
+        printf("telemetry sampler not found\n");
+        if (fp != stdout)
+            fclose(fp);
+        return 1;
+    }
+
+    int poll_us = 500000 / rate * depth;
+    poll_us = (poll_us < 1000) ? 1000 : poll_us;
+
+    signal(SIGINT, tlm_sigint);
+    signal(SIGTERM, tlm_sigint);
+    for (next = 0; !rc && !tlm_stop; ) {
+        rc  = spi_batch_read(&b, SMP_COUNT, &count, 1);
+        rc |= spi_batch_flush(&b);
+
+        /* Skip what was overwritten, leave a sample of slack for the writer */
+        uint32_t n = count - next;
+        if (n > depth - 1) {
+            lost += n - (depth - 1);
+            next = count - (depth - 1);
+            n = depth - 1;
+        }
+
+        /* Up to two reads, the second after the ring wraps */
+        uint32_t first = next % depth;
+        uint32_t n0 = (first + n > depth) ? depth - first : n;
+        rc |= spi_batch_read(&b, ring + first * SMP_WORDS * 4, rec,
+                    n0 * SMP_WORDS);
+        if (n > n0)
+            rc |= spi_batch_read(&b, ring, &rec[n0 * SMP_WORDS],
+                    (n - n0) * SMP_WORDS);
+        rc |= spi_batch_flush(&b);
+
+        for (k = 0; !rc && k < n; k++, next++) {
+            uint32_t *r = &rec[k * SMP_WORDS];
+            if (r[SMP_WORDS - 1] != next) {
+                lost++;
+                continue;
+            }
+            fwrite(r, SMP_WORDS * 4, 1, fp);
+            saved++;
+        }
+
+        if (verbose && n)
+            fprintf(stderr, "telemetry: %u samples, %llu saved, %llu lost\n",
+                n, (unsigned long long)saved, (unsigned long long)lost);
+        if (n < depth / 2)
+            usleep(poll_us);
+    }
+
+    rc |= spi_batch_write(&b, SMP_CTL, 0x0);
+    rc |= spi_batch_flush(&b);
+    if (fp != stdout)
+        fclose(fp);
+
+    fprintf(stderr, "telemetry: %llu samples saved, %llu lost\n",
+        (unsigned long long)saved, (unsigned long long)lost);
+    if (rc)
+        printf("transfer error!\n");
+    return rc ? 1 : 0;
+}
+
+/*
+ * SPI link benchmark. Measures single word read & write latency and block
+ * transfer throughput for a range of chunk sizes, at each of the given SPI
+ * clock rates. Only the scratch area is touched, harts keep running. Every
+ * block is read back and compared, so errors from a clock that's too fast
+ * for the current --dummy setting are counted rather than hidden.
+ */
+#define BENCH_BYTES (64 * 1024)     /* per throughput measurement */
+#define BENCH_ITERS 1000
+
+static uint64_t
+now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static int
+cmp_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t*)a;
+    uint64_t y = *(const uint64_t*)b;
+    return (x > y) - (x < y);
+}
+
+static void
+bench_report(const char *name, uint64_t *t, int n, int err)
+{
+    qsort(t, n, sizeof(t[0]), cmp_u64);
+    printf("  %-6s p50 %8.1fus  p99 %8.1fus  max %8.1fus  errors %d\n", name,
+        t[n / 2] / 1000.0, t[(n * 99) / 100] / 1000.0, t[n - 1] / 1000.0,
+        err);
+}
+
+int
+run_bench(int fd, const uint32_t *speeds, int nspeeds, int iters,
+    uint32_t scr_addr, uint32_t scr_len)
+{
+    static const int chunks[] = { 16, 32, 64, 128, 256, 512 };
+    int nw = scr_len / 4;
+    int passes = (BENCH_BYTES + scr_len - 1) / scr_len;
+    uint32_t *pat, *buf;
+    struct stat st;
+    uint64_t *t;
+    int s, c, k, n;
+    int rc = 0;
+
+    if (!fstat(fd, &st) && S_ISSOCK(st.st_mode)) {
+        printf("bench needs spidev, not a daemon connection\n");
+        return 1;
+    }
+
+    t = malloc(iters * sizeof(t[0]));
+    pat = malloc(scr_len);
+    buf = malloc(scr_len);
+    if (!t || !pat || !buf) {
+        free(t);
+        free(pat);
+        free(buf);
+        return 1;
+    }
+
+    for (s = 0; !rc && s < nspeeds; s++) {
+        uint32_t speed = speeds[s];
+        if (ioctl(fd, SPI_IOC_WR_MAX_SPEED_HZ, &speed) == -1) {
+            printf("can't set max speed hz: %u\n", speed);
+            rc = 1;
+            break;
+        }
+        printf("speed %u Hz, dummy %d, scratch 0x%x-0x%x\n", speed,
+            spi_dummy, scr_addr, scr_addr + scr_len - 1);
+
+        /* Single word latency, every write is checked by the next read */
+        int err = 0;
+        uint32_t data = 0;
+        for (k = 0; k < iters; k++) {
+            uint64_t t0 = now_ns();
+            rc |= spi_write(fd, scr_addr, 0x5a000000 ^ k);
+            t[k] = now_ns() - t0;
+        }
+        bench_report("write", t, iters, 0);
+        for (k = 0; k < iters; k++) {
+            rc |= spi_write(fd, scr_addr, 0xa5000000 ^ k);
+            uint64_t t0 = now_ns();
+            rc |= spi_read(fd, scr_addr, &data);
+            t[k] = now_ns() - t0;
+            err += (data != (0xa5000000 ^ k));
+        }
+        bench_report("read", t, iters, err);
+
+        /* Block throughput, kB/s and the share of the raw SPI bit rate */
+        printf("  %-6s %10s %6s %10s %6s %7s\n", "chunk", "write kB/s",
+            "wire", "read kB/s", "wire", "errors");
+        for (c = 0; !rc && c < sizeof(chunks) / sizeof(chunks[0]); c++) {
+            uint64_t t_wr = 0, t_rd = 0;
+
+            sbuf_len = chunks[c];
+            for (err = 0, n = 0; !rc && n < passes; n++) {
+                for (k = 0; k < nw; k++)
+                    pat[k] = ((uint32_t)n << 24) ^ ((uint32_t)k * 0x01010101) ^ speed;
+
+                uint64_t t0 = now_ns();
+                rc |= spi_write_block(fd, scr_addr, pat, nw);
+                uint64_t t1 = now_ns();
+                rc |= spi_read_block(fd, scr_addr, buf, nw);
+                uint64_t t2 = now_ns();
+
+                t_wr += t1 - t0;
+                t_rd += t2 - t1;
+                for (k = 0; k < nw; k++)
+                    err += (buf[k] != pat[k]);
+            }
+
+            double wr = (double)passes * scr_len * 1e6 / t_wr;
+            double rd = (double)passes * scr_len * 1e6 / t_rd;
+            printf("  %-6d %10.1f %5.1f%% %10.1f %5.1f%% %7d\n", chunks[c],
+                wr, wr * 800000.0 / speed, rd, rd * 800000.0 / speed, err);
+        }
+        sbuf_len = SBUF_LEN;
+    }
+
+    free(t);
+    free(pat);
+    free(buf);
+    if (rc)
+        printf("transfer error!\n");
+    return rc ? 1 : 0;
+}
+
+/*
+ * Performance counter readout, see source/wb_perf.v. With an interval the
+ * counters are cleared first and read after 'ms' milliseconds, otherwise
+ * the counts since the last clear are shown.
+ */
+#define PERF_CTL    0xC30000
+#define PERF_NHARTS 0xC30004
+#define PERF_SPI    0xC30010
+#define PERF_HART   0xC30020
+#define PERF_HARTS  8
+
+int
+run_perf(int fd, int ms)
+{
+    static spi_batch_t b;
+    uint32_t spi[2];
+    uint32_t h[PERF_HARTS][5];
+    uint32_t harts;
+    int n, rc = 0;
+
+    spi_batch_init(&b, fd);
+    rc |= spi_batch_read(&b, PERF_NHARTS, &harts, 1);
+    rc |= spi_batch_flush(&b);
+    if (rc) {
+        printf("transfer error!\n");
+        return 1;
+    }
+    if (harts > PERF_HARTS)
+        harts = PERF_HARTS;
+
+    if (ms > 0) {
+        rc |= spi_batch_write(&b, PERF_CTL, 0x3);
+        rc |= spi_batch_flush(&b);
+        usleep(ms * 1000);
+    }
+    rc |= spi_batch_write(&b, PERF_CTL, 0x1);
+    rc |= spi_batch_read(&b, PERF_SPI, spi, 2);
+    for (n = 0; n < harts; n++)
+        rc |= spi_batch_read(&b, PERF_HART + n * 0x20, h[n], 5);
+    rc |= spi_batch_flush(&b);
+    if (rc) {
+        printf("transfer error!\n");
+        return 1;
+    }
+
+    printf("%-5s %10s %10s %6s %10s %10s %10s\n", "hart", "cycles", "insns",
+        "cpi", "ibus", "dbus", "wait");
+    for (n = 0; n < harts; n++)
+        printf("%-5d %10u %10u %6.1f %10u %10u %10u\n", n, h[n][0], h[n][1],
+            h[n][1] ? (double)h[n][0] / h[n][1] : 0.0, h[n][2], h[n][3],
+            h[n][4]);
+    printf("spi   %u bus cycles, %u wait\n", spi[0], spi[1]);
+    return 0;
+}
+
 /*
  * Args:
  * -h print help
@@ -337,8 +1664,22 @@ show_help()
         "  -d data if omitted do read transaction, otherwise write data\n"
         "  -b write byte select, 0xF if omitted\n"
         "  -l load ROM image into memory, starting at specified address\n"
-        "  -r dump ROM image from BRAM to file\n"
+        "  -L load ROM image, only writing words that changed\n"
+        "  -r dump ROM image from BRAM to file, SRAM if -a is 0x800000\n"
+        "  -f run commands from script file, '-' reads from stdin\n"
+        "  -D run as daemon, serving clients on the specified UNIX socket\n"
+        "  -c connect to daemon on the specified UNIX socket, not spidev\n"
+        "  -t stream telemetry samples to a log file until interrupted\n"
+        "  --rate=HZ telemetry sample rate, 1000 if omitted\n"
+        "  --verify=readback|crc image verify mode, readback if omitted\n"
+        "  --speed=HZ SPI clock, 1000000 if omitted\n"
+        "  --dummy=N read turnaround bytes (0-15), needed above ~2MHz\n"
         "  -v be verbose\n"
+        "\n"
+        "  bench [HZ,...] SPI link benchmark at each clock, --speed if omitted\n"
+        "  perf [MS] performance counters, over MS milliseconds if given\n"
+        "  --iters=N latency samples per measurement, 1000 if omitted\n"
+        "  --scratch=ADDR[,LEN] memory bench may overwrite, LEN 2048 if omitted\n"
     );
 }
 
@@ -347,18 +1688,40 @@ main(int argc, char *argv[])
 {
         int rc, opt;
         int verbose = 0;
+        int verify = VERIFY_READBACK;
         int iswrite = 0;
         uint32_t addr = 0;
         uint32_t data = 0;
         uint32_t bsel = 0xF;
-        uint32_t dmem[BRAM_DEPTH]; // BRAM size is 16KB
-        uint32_t rmem[BRAM_DEPTH]; // used for read back / data compare
         FILE *fp = NULL;
         const char *rom = NULL;
+        const char *drom = NULL;
         const char *rdf = NULL;
+        const char *scr = NULL;
+        const char *dsock = NULL;
+        const char *csock = NULL;
+        const char *tlog = NULL;
+        int rate = 1000;
+        int iters = BENCH_ITERS;
+        uint32_t scr_addr = 0;
+        uint32_t scr_len = 0;
+        char *end;
         const char *dev = "/dev/spidev0.0";
+        uint32_t speed = 1000000;
+        static spi_batch_t b;
+
+        static const struct option lopts[] = {
+            { "verify", required_argument, NULL, 'V' },
+            { "speed",  required_argument, NULL, 'S' },
+            { "dummy",  required_argument, NULL, 'Y' },
+            { "rate",   required_argument, NULL, 'R' },
+            { "iters",  required_argument, NULL, 'I' },
+            { "scratch", required_argument, NULL, 'X' },
+            { NULL, 0, NULL, 0 }
+        };
 
-        while ((opt = getopt(argc, argv, "hvs:a:d:b:l:r:")) != -1) {
+        while ((opt = getopt_long(argc, argv, "hvs:a:d:b:l:L:r:f:D:c:t:",
+                        lopts, NULL)) != -1) {
             switch (opt) {
                 case 'h':
                     show_help();
@@ -366,15 +1729,78 @@ main(int argc, char *argv[])
                 case 'v':
                     verbose++;
                     break;
+                case 'V':
+                    if (!strcmp(optarg, "crc")) {
+                        verify = VERIFY_CRC;
+                    } else if (!strcmp(optarg, "readback")) {
+                        verify = VERIFY_READBACK;
+                    } else {
+                        printf("invalid verify mode: %s\n", optarg);
+                        return 1;
+                    }
+                    break;
+                case 'S':
+                    speed = (uint32_t)strtoul(optarg, NULL, 0);
+                    if (!speed) {
+                        printf("invalid SPI speed: %s\n", optarg);
+                        return 1;
+                    }
+                    break;
+                case 'Y':
+                    spi_dummy = (int)strtol(optarg, NULL, 0);
+                    if (spi_dummy < 0 || spi_dummy > 15) {
+                        printf("invalid dummy byte count: %s\n", optarg);
+                        return 1;
+                    }
+                    break;
                 case 's':
                     dev = optarg;
                     break;
                 case 'l':
                     rom = optarg;
                     break;
+                case 'L':
+                    drom = optarg;
+                    break;
                 case 'r':
                     rdf = optarg;
                     break;
+                case 'f':
+                    scr = optarg;
+                    break;
+                case 'D':
+                    dsock = optarg;
+                    break;
+                case 'c':
+                    csock = optarg;
+                    break;
+                case 't':
+                    tlog = optarg;
+                    break;
+                case 'R':
+                    rate = (int)strtol(optarg, NULL, 0);
+                    break;
+                case 'I':
+                    iters = (int)strtol(optarg, NULL, 0);
+                    if (iters < 1) {
+                        printf("invalid iteration count: %s\n", optarg);
+                        return 1;
+                    }
+                    break;
+                case 'X':
+                    scr_addr = (uint32_t)strtoull(optarg, &end, 0);
+                    scr_len = SCRATCH_LEN;
+                    if (*end == ',')
+                        scr_len = (uint32_t)strtoul(end + 1, &end, 0);
+                    if (*end || (scr_addr & 3) || !scr_len || (scr_len & 3) ||
+                            ((scr_addr & 0xC00000) != 0 &&
+                             (scr_addr & 0xC00000) != SRAM_ADDR) ||
+                            (scr_addr & 0x3FFFFF) + scr_len >
+                             MEM_SIZE(scr_addr)) {
+                        printf("invalid scratch area: %s\n", optarg);
+                        return 1;
+                    }
+                    break;
                 case 'a':
                     addr = (uint32_t)strtoull(optarg, NULL, 0);
                     break;
@@ -395,90 +1821,77 @@ main(int argc, char *argv[])
             }
         }
 
-        int fd = spi_open(dev, 0);
-        if (fd < 0)
-                return 1;
-
-        if (rdf) {
-            printf("Dumping BRAM to: %s\n", rdf);
-            rc = spi_read_block(fd, addr, rmem, BRAM_DEPTH);
-            if (rc) {
-                printf("mem read error\n");
-                return rc;
-            }
-
-            fp = fopen(rdf, "w+");
-            if (!fp) {
-                printf("Unable to open ROM dump file: %s\n", rdf);
-                return 1;
+        /* Subcommands */
+        const char *cmd = (optind < argc) ? argv[optind] : NULL;
+        const char *arg = (optind + 1 < argc) ? argv[optind + 1] : NULL;
+        uint32_t speeds[16];
+        int nspeeds = 0;
+        if (cmd && !strcmp(cmd, "bench")) {
+            char *p = (char*)arg;
+            while (p && *p && nspeeds < 16) {
+                speeds[nspeeds] = (uint32_t)strtoul(p, &p, 0);
+                if (!speeds[nspeeds++] || (*p && *p++ != ',')) {
+                    printf("invalid SPI speed list: %s\n", arg);
+                    return 1;
+                }
             }
-
-            rc = fwrite(rmem, 1, sizeof(rmem), fp);
-            fclose(fp);
-            if (rc != sizeof(rmem)) {
-                printf("Unable to write ROM dump file\n");
+            if (!nspeeds)
+                speeds[nspeeds++] = speed;
+            if (!scr_len) {
+                printf("bench needs a scratch area, see --scratch\n");
                 return 1;
             }
-            return 0;
+        } else if (cmd && strcmp(cmd, "perf")) {
+            printf("Unknown command: %s\n", cmd);
+            return 1;
         }
 
-        if (rom) {
-            printf("Loading mem file: %s\n", rom);
-            /* This assumes a LE host CPU */
-            
-            fp = fopen(rom, "r");
-            if (!fp) {
-                printf("Unable to open ROM file: %s\n", rom);
+        int fd = csock ? rio_connect(csock) : spi_open(dev, 0, speed);
+        if (fd < 0)
                 return 1;
-            }
 
-            int n = 0;
-            memset(dmem, 0, sizeof(dmem));
-            while (n < sizeof(dmem)) {
-                int rem = sizeof(dmem) - n;
-                char *ptr = &((char*)dmem)[n];
-                rc = fread(ptr, 1, rem, fp);
-                if (rc < 0)
-                    break;
+        if (nspeeds)
+            return run_bench(fd, speeds, nspeeds, iters, scr_addr, scr_len);
 
-                /* read some data, keep track */
-                n += rc;
-                if (rc < rem)
-                    break;
-            }
-            fclose(fp);
-            printf("mem file, read %d bytes\n", n);
+        if (cmd && !strcmp(cmd, "perf"))
+            return run_perf(fd, arg ? (int)strtol(arg, NULL, 0) : 0);
 
-            /* Always write the whole mem array */
-            rc = spi_write_block(fd, addr, dmem, BRAM_DEPTH);
-            if (rc) {
-                printf("mem write error\n");
-                return rc;
-            }
+        if (dsock)
+            return run_daemon(fd, dsock, verbose);
 
-            rc = spi_read_block(fd, addr, rmem, BRAM_DEPTH);
-            if (rc) {
-                printf("mem read error\n");
-                return rc;
-            }
+        if (tlog)
+            return run_telemetry(fd, tlog, rate, verbose);
 
-            for (n = 0; n < BRAM_DEPTH; n++) {
-                if (rmem[n] != dmem[n]) {
-                    printf("mem compare mismatch at addr: 0x%x\n", addr + n);
-                    return 1;
-                }
-                if (verbose)
-                    printf("0x%04X: 0x%08X\n", n, rmem[n]);
+        if (scr) {
+            fp = strcmp(scr, "-") ? fopen(scr, "r") : stdin;
+            if (!fp) {
+                printf("Unable to open script file: %s\n", scr);
+                return 1;
             }
-            
-            return 0;
+            rc = run_script(fd, fp, verify, verbose);
+            if (fp != stdin)
+                fclose(fp);
+            return rc;
         }
 
+        spi_batch_init(&b, fd);
+
+        if (rdf)
+            return batch_dump(&b, addr, rdf);
+
+        if (rom)
+            return batch_load(&b, addr, rom, verify, verbose);
+
+        if (drom)
+            return batch_load_delta(&b, addr, drom, verify, verbose);
+
         if (iswrite) {
-            rc = spi_write_be(fd, addr, data, bsel);
+            rc  = spi_batch_write_be(&b, addr, data, bsel);
+            rc |= spi_batch_flush(&b);
             printf("write: 0x%x=0x%08x\n", addr, data);
         } else {
-            rc = spi_read(fd, addr, &data);
+            rc  = spi_batch_read(&b, addr, &data, 1);
+            rc |= spi_batch_flush(&b);
             printf(" read: 0x%x=0x%08x\n", addr, data);
         }
 
@@ -487,4 +1900,3 @@ main(int argc, char *argv[])
 
         return rc;
 }
-